@@ -24,11 +24,21 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <termios.h>
+#include <time.h>
 #include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include <getopt.h>
+#ifdef HAVE_PTHREAD
+    #include <pthread.h>
+#endif
 
 /* wolfssl includes */
 #include <wolfssl/options.h>
@@ -71,6 +81,32 @@
 #define BLOCK_SIZE 16384
 #define MEGABYTE (1024*1024)
 #define MAX_THREADS 64
+#define DEFAULT_CHUNK (4*BLOCK_SIZE)    /* en/de crypt bytes per read/write */
+#define MAX_CHUNK (64*MEGABYTE)         /* largest -chunk accepted */
+#define IO_DEPTH 8                      /* chunks in flight with -io */
+#define MAX_DIGEST_SIZE 64              /* largest digest, sha512/blake2b */
+#define MAX_KEY_SIZE 32                 /* largest cipher key, aes-256 */
+#define KDF_ITERATIONS 4096             /* PBKDF2 count of files without one */
+#define KDF_MIN_ITERATIONS 1000         /* fewest -kdf-iter accepts */
+#define KDF_MAX_ITERATIONS 100000000    /* most -kdf-iter accepts */
+#define KDF_COUNT_FLAG 1                /* last salt byte when a count follows */
+#define KDF_COUNT_SIZE 4                /* big endian count after the salt */
+/* bytes of a derived key the ciphers read, 3des always reads 24 */
+#define KDF_KEY_SIZE(bits) ((bits) / 8 > 24 ? (bits) / 8 : 24)
+#define MAX_HASH_ALGS 6                 /* algorithms one -hash run takes */
+#define DIGEST_MISMATCH 1               /* a file doesn't match its manifest */
+#define MAX_BENCH_SIZES 16              /* buffer sizes one -sizes sweep takes */
+#define MAX_BENCH_REPS 100              /* most -reps runs of each benchmark */
+#define MAX_BENCH_CASES 32              /* room for the benchmark table */
+#define BENCH_FILE_SIZE (256*MEGABYTE)  /* default -bench file -size */
+#define HIST_SUB_BITS 8                 /* histogram buckets per power of two
+                                         * are 2^(HIST_SUB_BITS-1) */
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 2) << (HIST_SUB_BITS - 1))
+#define BENCH_LATENCIES 5               /* p50, p90, p99, p99.9 and max */
+#define BENCH_REGRESSION 2              /* slower than the -baseline allows */
+#define POOL_CANCELLED 130              /* stopped by SIGINT, what a shell
+                                         * reports for it */
+#define KEY_SLOT_SIZE 256               /* locked bytes per key, IV or -pwd */
 
  /* @VERSION 
   * Update every time library change, 
@@ -95,7 +131,26 @@ enum {
     TIME,
     VERIFY,
     VERBOSE,
-    X509
+    X509,
+    CHUNK,
+    THREADS,
+    MMAP,
+    BACKEND,
+    INLIST,
+    NULLDELIM,
+    TAG,
+    CHECK,
+    CHUNKS,
+    QUIET,
+    SIZES,
+    REPS,
+    FORMAT,
+    BASELINE,
+    THRESHOLD,
+    OPS,
+    KDFITER,
+    KDFTARGET,
+    LATENCY
 };
 
 /* Structure for holding long arguments */
@@ -116,6 +171,25 @@ static struct option long_options[] = {
     {"verify",  0,                 0, VERIFY    },
     {"verbose", 0,                 0, VERBOSE   },
     {"x509",    required_argument, 0, X509      },
+    {"chunk",   required_argument, 0, CHUNK     },
+    {"threads", required_argument, 0, THREADS   },
+    {"mmap",    0,                 0, MMAP      },
+    {"io",      required_argument, 0, BACKEND   },
+    {"inlist",  required_argument, 0, INLIST    },
+    {"null",    0,                 0, NULLDELIM },
+    {"tag",     0,                 0, TAG       },
+    {"check",   required_argument, 0, CHECK     },
+    {"chunks",  0,                 0, CHUNKS    },
+    {"quiet",   0,                 0, QUIET     },
+    {"sizes",   0,                 0, SIZES     },
+    {"reps",    required_argument, 0, REPS      },
+    {"format",  required_argument, 0, FORMAT    },
+    {"baseline", required_argument, 0, BASELINE },
+    {"threshold", required_argument, 0, THRESHOLD },
+    {"ops",     required_argument, 0, OPS       },
+    {"kdf-iter", required_argument, 0, KDFITER  },
+    {"kdf-target-ms", required_argument, 0, KDFTARGET },
+    {"latency", 0,                 0, LATENCY   },
     {"v",       0,                 0, 'v'       },
     {"version", 0,                 0, 'v'       },
     {0, 0, 0, 0}
@@ -123,6 +197,308 @@ static struct option long_options[] = {
 };
 
 
+/* single descriptor file stream used by the en/de crypt data paths */
+typedef struct WolfsslStream {
+    int     fd;                 /* open file descriptor */
+    int64_t offset;             /* current position in the file */
+    int64_t length;             /* length of the file */
+    byte*   map;                /* whole file when mapped, otherwise NULL */
+} WolfsslStream;
+
+/* backends for overlapping reads and writes with en/de cryption */
+enum {
+    WOLFSSL_IO_SYNC = 0,        /* read, en/de crypt, write, one at a time */
+    WOLFSSL_IO_URING,           /* io_uring, falls back to WOLFSSL_IO_THREAD */
+    WOLFSSL_IO_THREAD           /* reader and writer threads */
+};
+
+/* phases of the buffered data paths, timed for -bench file */
+enum {
+    WOLFSSL_PHASE_READ = 0,
+    WOLFSSL_PHASE_CRYPTO,       /* en/de cryption or hashing */
+    WOLFSSL_PHASE_WRITE,
+    WOLFSSL_PHASE_KDF,          /* deriving the key from the password */
+    WOLFSSL_PHASES
+};
+
+/* seconds spent in each phase, summed over a run */
+typedef struct WolfsslPhases {
+    double  seconds[WOLFSSL_PHASES];
+} WolfsslPhases;
+
+/* how the data paths move file data, set from the command line */
+typedef struct WolfsslIo {
+    int     chunk;              /* bytes read, processed and written at once */
+    int     threads;            /* worker threads for seekable work */
+    int     mmap;               /* 1 to map files instead of reading them */
+    int     backend;            /* one of the WOLFSSL_IO_ backends */
+    WolfsslPhases* phases;      /* time of each phase when set, only the
+                                 * synchronous buffered paths add to it */
+} WolfsslIo;
+
+/* how the benchmarks run, set from the command line */
+typedef struct WolfsslBenchOpts {
+    int     time;               /* seconds each test runs for */
+    int     sizes[MAX_BENCH_SIZES]; /* bytes per call, one test per size */
+    int     sizeCount;          /* 0 for each algorithm's own size */
+    int     threads;            /* most threads to scale to, 0 for none */
+    int     threadSweep;        /* 1 to double up to threads, else 1 and all */
+    int     reps;               /* timed runs of each test, after a warmup */
+    int     format;             /* one of the WOLFSSL_BENCH_ formats */
+    const char* baseline;       /* -format json results to compare with */
+    double  threshold;          /* percent slower than baseline that fails */
+    int     ops;                /* WOLFSSL_BENCH_ cipher operations to time */
+    int     file;               /* 1 to time the real file data paths */
+    int64_t fileSize;           /* bytes of the -bench file test file */
+    int     latency;            /* 1 to time each call into a histogram */
+} WolfsslBenchOpts;
+
+/* cipher operations the benchmarks time, any of them or'd together */
+enum {
+    WOLFSSL_BENCH_ENCRYPT  = 1,
+    WOLFSSL_BENCH_DECRYPT  = 2,
+    WOLFSSL_BENCH_KEYSETUP = 4, /* key schedule and IV, once per call */
+    WOLFSSL_BENCH_ALLOPS   = 7
+};
+
+/* how benchmark results are printed */
+enum {
+    WOLFSSL_BENCH_TEXT = 0,     /* tables for people */
+    WOLFSSL_BENCH_JSON,         /* one result object per line */
+    WOLFSSL_BENCH_CSV           /* a header row and one row per result */
+};
+
+/* one benchmark figure, kept for -format and -baseline. min, mean, stddev
+ * and p95 are MB/s, or keys/s for a keysetup or derive. */
+typedef struct WolfsslBenchResult {
+    char    name[32];           /* algorithm, "AES-CBC" */
+    char    op[12];             /* encrypt, decrypt, keysetup, derive or hash */
+    int     keySz;              /* key bits, 0 for a hash */
+    int     size;               /* bytes per call, 0 for keysetup and derive */
+    int     threads;            /* threads run at once */
+    double  mbs;                /* median MB/s, aggregate over threads */
+    double  ops;                /* median calls/s, aggregate over threads */
+    double  min;                /* slowest run */
+    double  mean;
+    double  stddev;
+    double  p95;
+    double  cpb;                /* median cycles/byte, or cycles/key */
+    double  latency[BENCH_LATENCIES];   /* p50, p90, p99, p99.9 and max ns
+                                         * per call with -latency, else 0 */
+} WolfsslBenchResult;
+
+/* HDR style histogram of call latencies in nanoseconds. Values below
+ * 2^HIST_SUB_BITS get a bucket each, above that every power of two is split
+ * into 2^(HIST_SUB_BITS-1) buckets, so a value is off by under 1% however
+ * large it is */
+typedef struct WolfsslHistogram {
+    uint64_t counts[HIST_BUCKETS];  /* values that fell in each bucket */
+    uint64_t total;             /* values recorded */
+    uint64_t sum;               /* of all of them, for the mean */
+    uint64_t min;
+    uint64_t max;
+} WolfsslHistogram;
+
+/* every result of one -bench run, in the order they were measured */
+typedef struct WolfsslBenchResults {
+    WolfsslBenchResult* list;   /* count of them in use */
+    int     count;
+    int     cap;                /* room before list must grow */
+} WolfsslBenchResults;
+
+/* a growing list of file names, each one owned by the list */
+typedef struct WolfsslFileList {
+    char**  names;              /* the names, count of them in use */
+    int     count;              /* names in the list */
+    int     cap;                /* room in names before it must grow */
+} WolfsslFileList;
+
+/* cipher context, keyed once per file and carrying the running IV */
+typedef struct WolfsslCipher WolfsslCipher;
+
+/* en/de crypts whole blocks from in to out, returns 0 on success */
+typedef int (*WolfsslCipherFunc)(WolfsslCipher* cipher, byte* out,
+                                                    const byte* in, word32 sz);
+
+struct WolfsslCipher {
+    union {
+#ifndef NO_AES
+        Aes      aes;
+#endif
+#ifndef NO_DES3
+        Des3     des3;
+#endif
+#ifdef HAVE_CAMELLIA
+        Camellia camellia;
+#endif
+        byte     none;
+    } ctx;                      /* key schedule and running IV */
+    WolfsslCipherFunc update;   /* set by wolfsslCipherInit for alg/mode */
+    int     block;              /* block size of the algorithm */
+    char    action;             /* 'e' to encrypt, 'd' to decrypt */
+};
+
+/* streaming digest, started once and fed the input a chunk at a time */
+typedef struct WolfsslDigest WolfsslDigest;
+
+/* hashes sz bytes of in into the running digest, returns 0 on success */
+typedef int (*WolfsslDigestUpdateFunc)(WolfsslDigest* digest, const byte* in,
+                                                                    word32 sz);
+
+/* writes the finished digest to out, returns 0 on success */
+typedef int (*WolfsslDigestFinalFunc)(WolfsslDigest* digest, byte* out);
+
+struct WolfsslDigest {
+    union {
+#ifndef NO_MD5
+        Md5      md5;
+#endif
+#ifndef NO_SHA
+        Sha      sha;
+#endif
+#ifndef NO_SHA256
+        Sha256   sha256;
+#endif
+#ifdef WOLFSSL_SHA384
+        Sha384   sha384;
+#endif
+#ifdef WOLFSSL_SHA512
+        Sha512   sha512;
+#endif
+#ifdef HAVE_BLAKE2
+        Blake2b  blake2b;
+#endif
+        byte     none;
+    } ctx;                      /* running state of the algorithm */
+    WolfsslDigestUpdateFunc update; /* set by wolfsslDigestInit for alg */
+    WolfsslDigestFinalFunc  final;
+    int     size;               /* bytes of digest produced */
+};
+
+/* the algorithms one -hash run digests every file with, "md5,sha256" */
+typedef struct WolfsslHashAlgs {
+    char*   names[MAX_HASH_ALGS];   /* hash algorithms, in output order */
+    int     sizes[MAX_HASH_ALGS];   /* digest size of each */
+    int     count;                  /* algorithms in the list */
+    int     total;                  /* sum of sizes */
+} WolfsslHashAlgs;
+
+/* digests of every chunk of a file, so a manifest check can stop reading a
+ * file at its first bad chunk
+ */
+typedef struct WolfsslChunkDigests {
+    byte*   digests;            /* count digests, one after the other */
+    int     count;              /* chunks in the file */
+    int     chunk;              /* bytes covered by each digest */
+} WolfsslChunkDigests;
+
+/* runs job idx with a read buffer the worker keeps across jobs, returns 0,
+ * DIGEST_MISMATCH or an error
+ */
+typedef int (*WolfsslHashJobFunc)(void* ctx, int idx, byte* input);
+
+/* called in job order with what job idx returned and errno after it */
+typedef void (*WolfsslHashDoneFunc)(void* ctx, int idx, int ret, int err);
+
+/* a seekable en/de cryption split into ranges across worker threads, ctr
+ * either way or cbc decryption
+ */
+typedef struct WolfsslParallel {
+    const char*    alg;         /* algorithm from wolfsslGetAlgo */
+    const char*    mode;        /* mode from wolfsslGetAlgo */
+    const byte*    key;         /* key shared by every worker */
+    const byte*    iv;          /* IV or initial counter of the message */
+    int            block;       /* block size of the algorithm */
+    char           action;      /* 'e' to encrypt, 'd' to decrypt */
+    WolfsslStream* in;          /* input, only read with ReadAt */
+    WolfsslStream* out;         /* output, only written with WriteAt */
+    int64_t        inOffset;    /* where the data starts in the input */
+    int64_t        outOffset;   /* where the data starts in the output */
+    int64_t        length;      /* bytes of data in the input */
+    int            pad;         /* pad bytes added after length */
+    int            chunk;       /* bytes a worker handles at a time */
+    int            threads;     /* number of workers, up to MAX_THREADS */
+    byte           last;        /* set to the last byte of the output */
+} WolfsslParallel;
+
+/* runs one pool task. worker is the index of the pool thread running it,
+ * 0 to threads - 1, so tasks can use per thread buffers. Returns 0 or an error.
+ */
+typedef int (*WolfsslTaskFunc)(void* arg, int worker);
+
+/* called on the pool thread once a task has run, or with POOL_CANCELLED
+ * when it never will
+ */
+typedef void (*WolfsslTaskDoneFunc)(void* arg, int ret);
+
+/* where a task is, see wolfsslPoolPoll */
+enum {
+    WOLFSSL_TASK_QUEUED = 0,
+    WOLFSSL_TASK_RUNNING,
+    WOLFSSL_TASK_DONE
+};
+
+/* a unit of work and the future of its result, owned by the caller and
+ * untouched by the pool once done
+ */
+typedef struct WolfsslTask {
+    WolfsslTaskFunc     func;   /* the work */
+    WolfsslTaskDoneFunc done;   /* completion callback, NULL for none */
+    void*               arg;    /* passed to func and done */
+    int                 ret;    /* what func returned, once done */
+    int                 state;  /* one of the WOLFSSL_TASK_ states */
+    struct WolfsslTask* next;   /* behind it in its queue or deque */
+    struct WolfsslTask* prev;   /* ahead of it in its deque */
+} WolfsslTask;
+
+/* tasks a worker spawned. It runs the newest itself, idle workers steal
+ * the oldest, which split first and are the biggest
+ */
+typedef struct WolfsslDeque {
+    WolfsslTask*    head;       /* oldest, stolen from here */
+    WolfsslTask*    tail;       /* newest, its owner takes from here */
+} WolfsslDeque;
+
+/* worker threads taking tasks off a bounded queue in submission order,
+ * and off each other's deques of spawned tasks once that is empty
+ */
+typedef struct WolfsslPool {
+    int             threads;    /* workers running, 0 runs tasks on submit */
+    int             depth;      /* tasks queued before submitting waits */
+    int             queued;     /* tasks waiting for a worker */
+    int             spawned;    /* tasks waiting in the deques */
+    int             stop;       /* workers exit once the queue is empty */
+    int             cancelled;  /* queued tasks are dropped, not run */
+    WolfsslTask*    head;       /* next task to run */
+    WolfsslTask*    tail;       /* last task submitted */
+#ifdef HAVE_PTHREAD
+    WolfsslDeque    deques[MAX_THREADS];    /* one per worker */
+    pthread_mutex_t lock;       /* guards everything above and task states */
+    pthread_cond_t  work;       /* a task was queued or the pool stops */
+    pthread_cond_t  room;       /* the queue has room */
+    pthread_cond_t  finished;   /* a task is done */
+    pthread_t       tids[MAX_THREADS];  /* the workers */
+    int             next;       /* index the next worker to start takes */
+#endif
+} WolfsslPool;
+
+/* en/de crypts one chunk in place, last is set for the final chunk of the
+ * message. Returns the number of bytes to write or a negative error.
+ */
+typedef int (*WolfsslAsyncFunc)(void* ctx, byte* buf, int sz, int last);
+
+/* a message en/de crypted chunk by chunk with reads and writes overlapped */
+typedef struct WolfsslAsync {
+    WolfsslStream*   in;        /* input, only read with ReadAt */
+    WolfsslStream*   out;       /* output, only written with WriteAt */
+    int64_t          inOffset;  /* where the data starts in the input */
+    int64_t          outOffset; /* where the data starts in the output */
+    int64_t          length;    /* bytes of data in the input */
+    int              chunk;     /* bytes per buffer, a multiple of the block */
+    WolfsslAsyncFunc func;      /* called in message order on every chunk */
+    void*            ctx;       /* passed to func */
+} WolfsslAsync;
+
 /* encryption argument function
  *
  * @param argc holds all command line input
@@ -191,8 +567,20 @@ int wolfsslGetAlgo(char* name, char** alg, char** mode, int* size);
  * @param size size as determined by wolfsslGetAlgo
  * @param salt the buffer to store the resulting salt after it's generated
  * @param pad a flag to let us know if there are padded bytes or not
+ * @param iterations PBKDF2 iterations, KDF_ITERATIONS unless -kdf-iter or
+ *        -kdf-target-ms picked another count
  */
-int wolfsslGenKey(RNG* rng, byte* pwdKey, int size, byte* salt, int pad);
+int wolfsslGenKey(RNG* rng, byte* pwdKey, int size, byte* salt, int pad,
+                                                            int iterations);
+
+/* times PBKDF2 on this machine and returns the iteration count that takes
+ * about targetMs milliseconds, within KDF_MIN_ITERATIONS and
+ * KDF_MAX_ITERATIONS
+ *
+ * @param targetMs the time one key derivation should take
+ * @param size size as determined by wolfsslGetAlgo
+ */
+int wolfsslKdfCalibrate(double targetMs, int size);
 
 /* secure entry of password 
  *
@@ -208,14 +596,27 @@ int wolfsslNoEcho(char* pwdKey, int size);
  */
 void wolfsslAppend(char* s, char c);
 
-/* interrupt function
+/* finds current time during runtime, in seconds from CLOCK_MONOTONIC */
+double wolfsslGetTime(void);
+
+/* starts timing a phase of a data path
  *
- * @param signo gets type cast to void, interrupts the loop.
+ * @param io the phases to add to, when io->phases is set
+ *
+ * @return the current time, 0 when io->phases is not set
  */
-void wolfsslStop(int signo);
+double wolfsslPhaseStart(const WolfsslIo* io);
 
-/* finds current time during runtime */
-double wolfsslGetTime(void);
+/* adds the time since start to one phase of io->phases, if it is set
+ *
+ * @param io the phases to add to
+ * @param phase one of the WOLFSSL_PHASE_ values
+ * @param start what wolfsslPhaseStart returned
+ */
+void wolfsslPhaseEnd(const WolfsslIo* io, int phase, double start);
+
+/* reads the time stamp counter with rdtsc, 0 on processors without one */
+uint64_t wolfsslCycles(void);
 
 /* A function to convert from Hex to Binary
  *
@@ -237,7 +638,7 @@ int wolfsslHexToBin(const char* h1, byte** b1, word32* b1Sz,
                     const char* h3, byte** b3, word32* b3Sz,
                     const char* h4, byte** b4, word32* b4Sz);
 
-/* A function to free malloced byte* buffers after conversion
+/* A function to wipe and free wolfsslBufAlloc buffers after conversion
  *
  * @param b1 a buffer to be freed, can be set to NULL
  * @param b2 a buffer to be freed, can be set to NULL
@@ -247,12 +648,297 @@ int wolfsslHexToBin(const char* h1, byte** b1, word32* b1Sz,
  */
 void wolfsslFreeBins(byte* b1, byte* b2, byte* b3, byte* b4, byte* b5);
 
+/* converts a hex string straight into a buffer the caller owns, such as a
+ * wolfsslKeyAlloc slot, so no copy of the secret is left elsewhere
+ *
+ * @param h a char array containing hex values to be converted
+ * @param b the buffer to store the result in
+ * @param bSz room in b, set to the bytes converted. BUFFER_E if too small
+ */
+int wolfsslHexToBuf(const char* h, byte* b, word32* bSz);
+
+/* hands out a cache line aligned buffer of at least sz bytes, recycled
+ * from an earlier wolfsslBufFree of the same size class when there is one.
+ * Buffers of 2 MB and up are mapped starting on a 2 MB boundary, so they
+ * get transparent huge pages where the system offers them. Contents are not
+ * zeroed for you.
+ *
+ * @param sz bytes wanted
+ */
+byte* wolfsslBufAlloc(size_t sz);
+
+/* wipes the bytes asked for and keeps the buffer for reuse, NULL is fine
+ *
+ * @param buf a buffer from wolfsslBufAlloc
+ */
+void wolfsslBufFree(byte* buf);
+
+/* returns every buffer kept for reuse to the system, called on exit */
+void wolfsslBufDrain(void);
+
+/* hands out a zeroed KEY_SLOT_SIZE slot of locked memory for a password,
+ * key or IV. Slots come from regions locked once and kept out of core
+ * dumps, between guard pages, so taking one makes no system call.
+ * NULL if sz is over KEY_SLOT_SIZE or no memory is left.
+ *
+ * @param sz bytes wanted
+ */
+byte* wolfsslKeyAlloc(size_t sz);
+
+/* wipes a whole slot and returns it to the arena, NULL is fine
+ *
+ * @param key a slot from wolfsslKeyAlloc
+ */
+void wolfsslKeyFree(byte* key);
+
+/* wipes and frees the slots of an en/de cryption
+ *
+ * @param k1 a slot to be freed, can be set to NULL
+ * @param k2 a slot to be freed, can be set to NULL
+ * @param k3 a slot to be freed, can be set to NULL
+ */
+void wolfsslFreeKeys(byte* k1, byte* k2, byte* k3);
+
+/* wipes, unlocks and unmaps the whole arena, called on exit */
+void wolfsslKeyDrain(void);
+
+/* adds a copy of a file name to a list
+ *
+ * @param list the list to grow
+ * @param name the name to add
+ */
+int wolfsslFileListAdd(WolfsslFileList* list, const char* name);
+
+/* adds every name found in a file to a list, skipping empty names
+ *
+ * @param list the list to grow
+ * @param file the file holding the names, "-" for stdin
+ * @param delim what separates the names, '\n' or '\0'
+ */
+int wolfsslFileListRead(WolfsslFileList* list, const char* file, int delim);
+
+/* sizes of the files in a list, 0 for any that isn't a regular file. The
+ * caller frees the array, NULL when out of memory.
+ *
+ * @param list the files to stat
+ */
+int64_t* wolfsslFileListSizes(const WolfsslFileList* list);
+
+/* frees the names held by a list
+ *
+ * @param list the list to empty
+ */
+void wolfsslFileListFree(WolfsslFileList* list);
+
+/* parses a size argument with an optional k, m or g suffix
+ *
+ * @param str the string from the command line. Example: "64k"
+ * @param size set to the number of bytes str describes
+ */
+int wolfsslParseSize(const char* str, int64_t* size);
+
+/* opens a stream on a file, keeping one descriptor for its whole lifetime
+ *
+ * @param stream the stream to set up
+ * @param name the name of the file to open
+ * @param mode 'r' to read an existing file, 'w' to create or truncate one
+ */
+int wolfsslStreamOpen(WolfsslStream* stream, const char* name, char mode);
+
+/* reads from a stream, returns the number of bytes read or FREAD_ERROR.
+ * Only returns less than sz at the end of the file.
+ *
+ * @param stream the stream to read from
+ * @param buf the buffer to fill
+ * @param sz the number of bytes wanted
+ */
+int wolfsslStreamRead(WolfsslStream* stream, byte* buf, int sz);
+
+/* writes the whole buffer to a stream, returns 0 or FWRITE_ERROR
+ *
+ * @param stream the stream to write to
+ * @param buf the data to write
+ * @param sz the number of bytes in buf
+ */
+int wolfsslStreamWrite(WolfsslStream* stream, const byte* buf, int sz);
+
+/* reads at an offset without moving the stream, for use by several threads
+ * at once. Returns the number of bytes read or FREAD_ERROR.
+ *
+ * @param stream the stream to read from
+ * @param buf the buffer to fill
+ * @param sz the number of bytes wanted
+ * @param offset where in the file to read from
+ */
+int wolfsslStreamReadAt(WolfsslStream* stream, byte* buf, int sz,
+                                                               int64_t offset);
+
+/* writes at an offset without moving the stream, for use by several threads
+ * at once. Returns 0 or FWRITE_ERROR.
+ *
+ * @param stream the stream to write to
+ * @param buf the data to write
+ * @param sz the number of bytes in buf
+ * @param offset where in the file to write to
+ */
+int wolfsslStreamWriteAt(WolfsslStream* stream, const byte* buf, int sz,
+                                                               int64_t offset);
+
+/* sets the length of the file behind a stream, used to preallocate output
+ *
+ * @param stream the stream to resize
+ * @param length the new length of the file
+ */
+int wolfsslStreamResize(WolfsslStream* stream, int64_t length);
+
+/* maps the whole file behind a stream to stream->map. An output stream is
+ * sized with wolfsslStreamResize first. Empty files leave map as NULL.
+ *
+ * @param stream the stream to map
+ * @param mode 'r' to map read-only for sequential access, 'w' read-write
+ */
+int wolfsslStreamMap(WolfsslStream* stream, char mode);
+
+/* removes the mapping made by wolfsslStreamMap
+ *
+ * @param stream the mapped stream
+ */
+void wolfsslStreamUnmap(WolfsslStream* stream);
+
+/* closes a stream
+ *
+ * @param stream the stream to close
+ */
+void wolfsslStreamClose(WolfsslStream* stream);
+
+/* sets up a cipher context once for a whole message
+ *
+ * @param cipher the context to set up
+ * @param alg the algorithm from wolfsslGetAlgo (aes, 3des or camellia)
+ * @param mode the mode from wolfsslGetAlgo (cbc or ctr)
+ * @param key the key to schedule
+ * @param iv the initial IV or counter
+ * @param block the block size as determined by wolfsslGetAlgo
+ * @param action 'e' to encrypt or 'd' to decrypt
+ */
+int wolfsslCipherInit(WolfsslCipher* cipher, const char* alg,
+                const char* mode, const byte* key, const byte* iv, int block,
+                char action);
+
+/* sets up a cipher context with a key of keyBits. wolfsslCipherInit keys
+ * aes and camellia with a block's worth of key whatever the size asked for,
+ * which en/decrypted files depend on.
+ *
+ * @param keyBits 128, 192 or 256, or 56, 112 or 168 for 3des where key
+ *        holds one, two or three 8 byte DES keys
+ * the other parameters are those of wolfsslCipherInit
+ */
+int wolfsslCipherInitEx(WolfsslCipher* cipher, const char* alg,
+                const char* mode, const byte* key, int keyBits,
+                const byte* iv, int block, char action);
+
+/* en/de crypts whole blocks, continuing from the previous call */
+#define wolfsslCipherUpdate(cipher, out, in, sz) \
+    ((cipher)->update((cipher), (out), (in), (sz)))
+
+/* en/de crypts the last piece of a message. Returns the number of bytes
+ * placed in out or a negative error.
+ *
+ * @param cipher the context set up by wolfsslCipherInit
+ * @param out the output buffer, at least sz rounded up to a block
+ * @param in the input, when encrypting it needs room for the padding
+ * @param sz the number of bytes in in
+ * @param padded when decrypting, if the message carries padding to remove
+ */
+int wolfsslCipherFinal(WolfsslCipher* cipher, byte* out, byte* in, int sz,
+                                                                   int padded);
+
+/* clears a cipher context
+ *
+ * @param cipher the context to clear
+ */
+void wolfsslCipherFree(WolfsslCipher* cipher);
+
+/* runs a WolfsslParallel job, one contiguous range per worker thread.
+ * Only available when built with thread support (HAVE_PTHREAD).
+ *
+ * @param job the description of the en/de cryption
+ */
+int wolfsslParallelCrypt(WolfsslParallel* job);
+
+/* runs a WolfsslAsync job with up to IO_DEPTH chunks in flight. Uses
+ * io_uring when asked and available, otherwise a reader and a writer thread,
+ * otherwise plain reads and writes.
+ *
+ * @param job the message, streams and per chunk function
+ * @param backend WOLFSSL_IO_URING or WOLFSSL_IO_THREAD
+ */
+int wolfsslAsyncRun(WolfsslAsync* job, int backend);
+
+/* starts a pool of worker threads and catches SIGINT so running work can
+ * stop cleanly. Fewer threads start if the system refuses more, none without
+ * thread support (HAVE_PTHREAD), and tasks then run as they are submitted.
+ *
+ * @param pool the pool to start
+ * @param threads the workers wanted, up to MAX_THREADS
+ * @param depth the most tasks queued before wolfsslPoolSubmit waits
+ */
+int wolfsslPoolInit(WolfsslPool* pool, int threads, int depth);
+
+/* queues a task, waiting while the queue is full. Returns POOL_CANCELLED,
+ * with the task done, once the pool is cancelled.
+ *
+ * @param pool the pool to run on
+ * @param task the caller's task, must stay put until done
+ * @param func the work
+ * @param done called once it ran or was dropped, NULL for none
+ * @param arg passed to func and done
+ */
+int wolfsslPoolSubmit(WolfsslPool* pool, WolfsslTask* task,
+                WolfsslTaskFunc func, WolfsslTaskDoneFunc done, void* arg);
+
+/* queues a task from inside a running one, onto the deque of the worker
+ * running it, never waits. Runs it at once when the pool has no workers.
+ *
+ * @param pool the pool the running task is on
+ * @param worker the index the running task was handed
+ * @param task the caller's task, must stay put until done
+ * @param func the work
+ * @param done called once it ran or was dropped, NULL for none
+ * @param arg passed to func and done
+ */
+int wolfsslPoolSpawn(WolfsslPool* pool, int worker, WolfsslTask* task,
+                WolfsslTaskFunc func, WolfsslTaskDoneFunc done, void* arg);
+
+/* returns 1 if a task is done, 0 if it is still queued or running */
+int wolfsslPoolPoll(WolfsslPool* pool, WolfsslTask* task);
+
+/* waits for a task and returns what it returned, POOL_CANCELLED if dropped */
+int wolfsslPoolWait(WolfsslPool* pool, WolfsslTask* task);
+
+/* drops every queued and spawned task, running ones finish or see
+ * wolfsslPoolCancelled
+ */
+void wolfsslPoolCancel(WolfsslPool* pool);
+
+/* returns 1 once the pool is cancelled or SIGINT arrived, long tasks check it
+ * between chunks. pool may be NULL to check for SIGINT alone.
+ */
+int wolfsslPoolCancelled(WolfsslPool* pool);
+
+/* runs or drops what is queued, stops the workers and frees the pool */
+void wolfsslPoolFree(WolfsslPool* pool);
+
 /* function to display stats results from benchmark
  *
- * @param start the time when the benchmark was started
- * @param blockSize the block size of the algorithm being benchmarked
+ * @param seconds how long the benchmark ran
+ * @param cycles time stamp counter ticks it took, 0 if unknown
+ * @param blockSize the block size of the algorithm being benchmarked, 0
+ *        for key setups and derivations
+ * @param blocks the number of blocks processed
  */
-void wolfsslStats(double start, int blockSize, int64_t blocks);
+void wolfsslStats(double seconds, uint64_t cycles, int blockSize,
+                                                                int64_t blocks);
 
 /* encryption function
  *
@@ -270,10 +956,15 @@ void wolfsslStats(double start, int blockSize, int64_t blocks);
  * @param block size of block as determined by the algorithm being used
  * @param ivCheck a flag if user inputs a specific IV
  * @param inputHex a flag to specify encrypting hex data, instead of byte data
+ * @param iterations PBKDF2 iterations for a password, written after the salt
+ *        when it isn't KDF_ITERATIONS so decryption uses the same count
+ * @param io the chunk size, worker threads for seekable (ctr) modes and
+ *        whether to map the files
  */
 int wolfsslEncrypt(char* alg, char* mode, byte* pwdKey, byte* key, int size, 
 								char* in, char* out, byte* iv, int block, 
-                                int ivCheck, int inputHex);
+                                int ivCheck, int inputHex, int iterations,
+                                const WolfsslIo* io);
 
 /* decryption function
  *
@@ -291,26 +982,248 @@ int wolfsslEncrypt(char* alg, char* mode, byte* pwdKey, byte* key, int size,
  * @param block size of block as determined by the algorithm being used
  * @param keyType let's decrypt know if it's using a password based key or a 
  *        hexidecimal, user specified key.
+ * @param io the chunk size, worker threads for ctr or cbc decryption and
+ *        whether to map the files
  */
 int wolfsslDecrypt(char* alg, char* mode, byte* pwdKey, byte* key, int size, 
-						char* in, char* out, byte* iv, int block, int keyType);
+						char* in, char* out, byte* iv, int block, int keyType,
+                        const WolfsslIo* io);
 
 /* benchmarking function 
  *
- * @param timer a timer to be started and stopped for benchmarking purposes
- * @param option a flag to allow benchmark execution
+ * @param opts the time per test and the buffer sizes to sweep, if any
+ * @param option 1 for each benchmark to run, indexed like wolfsslBenchName
+ */
+int wolfsslBenchmark(const WolfsslBenchOpts* opts, int* option);
+
+/* names the benchmarks this build has, which -bench selects by and -help
+ * lists, from the table wolfsslBenchmark runs
+ *
+ * @param idx the index of a benchmark in the table
+ *
+ * @return its name, NULL when idx is past the last
+ */
+const char* wolfsslBenchName(int idx);
+
+/* encrypts, decrypts and hashes a generated file of opts->fileSize bytes
+ * through the real data paths, printing the time of each stage split into
+ * read, crypto, write and key derivation, and checks the round trip
+ *
+ * @param opts fileSize is the size of the test file
  */
-int wolfsslBenchmark(int timer, int* option);
+int wolfsslBenchFile(const WolfsslBenchOpts* opts);
+
+/* keeps a copy of one result
+ *
+ * @param results the results so far
+ * @param result the one to add
+ */
+int wolfsslBenchAdd(WolfsslBenchResults* results,
+                                            const WolfsslBenchResult* result);
+
+/* prints the results as JSON or CSV, along with the processor, system and
+ * library they were measured on
+ *
+ * @param results the results of the run
+ * @param format WOLFSSL_BENCH_JSON or WOLFSSL_BENCH_CSV
+ */
+void wolfsslBenchReport(const WolfsslBenchResults* results, int format);
+
+/* compares results with a file -format json wrote earlier, printing the
+ * change of each. Returns BENCH_REGRESSION when any result is more than
+ * threshold percent slower than its baseline.
+ *
+ * @param results the results of the run
+ * @param baseline the JSON file to compare with
+ * @param threshold percent slower that counts as a regression
+ * @param out where to print the comparison
+ */
+int wolfsslBenchCompare(const WolfsslBenchResults* results,
+                        const char* baseline, double threshold, FILE* out);
+
+/* frees the list of results
+ *
+ * @param results the results to free
+ */
+void wolfsslBenchResultsFree(WolfsslBenchResults* results);
+
+/* empties a histogram
+ *
+ * @param hist the histogram to empty
+ */
+void wolfsslHistogramInit(WolfsslHistogram* hist);
+
+/* counts one value in its bucket
+ *
+ * @param hist the histogram
+ * @param ns the value, a latency in nanoseconds
+ */
+void wolfsslHistogramRecord(WolfsslHistogram* hist, uint64_t ns);
+
+/* adds every value of one histogram to another, as when threads finish
+ *
+ * @param to the histogram to add to
+ * @param from the histogram to add
+ */
+void wolfsslHistogramMerge(WolfsslHistogram* to, const WolfsslHistogram* from);
+
+/* finds the value pct percent of the recorded values are at or below, as
+ * the highest value of its bucket. 100 gives the exact max.
+ *
+ * @param hist the histogram
+ * @param pct the percentile, 0-100
+ */
+uint64_t wolfsslHistogramPercentile(const WolfsslHistogram* hist, double pct);
 
 /* hashing function 
  *
- * @param in 
- * @param len
- * @param out
- * @param alg
- * @param size
+ * @param in the file to hash, or the text to hash if no such file exists
+ * @param out the file to write the digest to, stdout if NULL
+ * @param alg the hash algorithm
+ * @param size the digest size
+ * @param io the read size and whether to map the input file
+ */
+int wolfsslHash(char* in, char* out, char* alg, int size, const WolfsslIo* io);
+
+/* hashes one file with a streaming digest, returns FREAD_ERROR when the
+ * file can't be opened or read
+ *
+ * @param name the file to hash
+ * @param alg the hash algorithm
+ * @param size the digest size
+ * @param io the read size and whether to map the file
+ * @param input a buffer of io->chunk bytes, reused across files
+ * @param output receives size bytes of digest
+ */
+int wolfsslHashFile(const char* name, const char* alg, int size,
+                            const WolfsslIo* io, byte* input, byte* output);
+
+/* hashes one file like wolfsslHashFile and also every chunks->chunk bytes
+ * of it. verify 0 fills chunks in, its digests are then the caller's to
+ * free. verify 1 compares against chunks and returns DIGEST_MISMATCH as
+ * soon as a chunk or the number of chunks differs.
+ *
+ * @param name the file to hash
+ * @param alg the hash algorithm
+ * @param size the digest size
+ * @param io the read size and whether to map the file
+ * @param input a buffer of io->chunk bytes, reused across files
+ * @param output receives size bytes of digest
+ * @param chunks the chunk size and, when verifying, the expected digests
+ * @param verify 1 to check chunks rather than fill it in
+ */
+int wolfsslHashFileChunks(const char* name, const char* alg, int size,
+                    const WolfsslIo* io, byte* input, byte* output,
+                    WolfsslChunkDigests* chunks, int verify);
+
+/* hashes one file with several algorithms while reading it only once
+ *
+ * @param name the file to hash
+ * @param algs the hash algorithms and their digest sizes
+ * @param io the read size and whether to map the file
+ * @param input a buffer of io->chunk bytes, reused across files
+ * @param output receives algs->total bytes, the digests in algs order
+ */
+int wolfsslHashFileAlgs(const char* name, const WolfsslHashAlgs* algs,
+                            const WolfsslIo* io, byte* input, byte* output);
+
+/* runs count jobs on a pool of worker threads, the hashing and checking of
+ * file lists share it
+ *
+ * @param count the number of jobs
+ * @param threads the most workers to start
+ * @param chunk the size of the read buffer each worker hands its jobs
+ * @param sizes bytes each job reads, the biggest start first. NULL starts
+ *        them in job order
+ * @param job runs one job on a worker
+ * @param done reports one job, called on this thread in job order
+ * @param ctx passed to job and done
+ */
+int wolfsslHashRun(int count, int threads, int chunk, const int64_t* sizes,
+        WolfsslHashJobFunc job, WolfsslHashDoneFunc done, void* ctx);
+
+/* hashes many files on io->threads worker threads, printing one
+ * sha256sum style line per file and algorithm in list order
+ *
+ * @param files the files to hash
+ * @param out the file to write the lines to, stdout if NULL
+ * @param algs the hash algorithms, each file is read once for all of them
+ * @param io the read size, worker threads and whether to map the files
+ * @param tag 1 for BSD style "SHA256 (name) = digest" lines
+ * @param chunks 1 to put a "#chunks" line of per chunk digests before each
+ *        file's line, for -check to stop early on, one algorithm only
+ */
+int wolfsslHashFiles(WolfsslFileList* files, char* out,
+                const WolfsslHashAlgs* algs, const WolfsslIo* io, int tag,
+                int chunks);
+
+/* verifies the files listed in a manifest on io->threads worker threads,
+ * printing "name: OK" or "name: FAILED" per file and a summary
+ *
+ * @param manifest sha256sum or BSD style lines, or bare digests like
+ *        tests/byte-hashes.sha1 which are paired in order with files
+ * @param files the files bare digests belong to, can be empty
+ * @param alg the hash algorithm
+ * @param size the digest size
+ * @param io the read size, worker threads and whether to map the files
+ * @param quiet 1 to only print failures and the summary
+ */
+int wolfsslHashCheck(const char* manifest, WolfsslFileList* files, char* alg,
+                                    int size, const WolfsslIo* io, int quiet);
+
+/* prints the "#chunks <bytes per chunk> <digest> ..." line of a file
+ *
+ * @param out where to print
+ * @param chunks the digests of the file's chunks
+ * @param size the digest size
+ */
+void wolfsslHashPrintChunks(FILE* out, const WolfsslChunkDigests* chunks,
+                                                                    int size);
+
+/* prints one line of wolfsslHashFiles output
+ *
+ * @param out where to print
+ * @param alg the hash algorithm
+ * @param digest the digest of the file
+ * @param size the digest size
+ * @param name the file name, escaped as coreutils does if needed
+ * @param tag 1 for BSD style lines
+ */
+void wolfsslHashPrint(FILE* out, const char* alg, const byte* digest,
+                                        int size, const char* name, int tag);
+
+/* name of a hash algorithm as BSD style lines spell it, "SHA256" for sha256
+ *
+ * @param alg the hash algorithm
+ * @param size the digest size, shorter blake2b digests get a suffix
+ * @param buf room to build a name in
+ * @param sz the size of buf
+ */
+const char* wolfsslHashTagName(const char* alg, int size, char* buf, int sz);
+
+/* starts a streaming digest
+ *
+ * @param digest the digest to set up
+ * @param alg the hash algorithm, as accepted by wolfsslHashSetup
+ * @param size the digest size, only blake2b uses it to pick its output
+ */
+int wolfsslDigestInit(WolfsslDigest* digest, const char* alg, int size);
+
+/* hashes sz more bytes, sz is a word32 as the algorithms take */
+#define wolfsslDigestUpdate(d, i, s) ((d)->update((d), (i), (s)))
+
+/* finishes a digest, writing digest->size bytes to out
+ *
+ * @param digest the running digest
+ * @param out the buffer for the digest
+ */
+int wolfsslDigestFinal(WolfsslDigest* digest, byte* out);
+
+/* clears the state of a digest
+ *
+ * @param digest the digest to clear
  */
-int wolfsslHash(char* in, char* out, char* alg, int size);
+void wolfsslDigestFree(WolfsslDigest* digest);
 /*
  * get the current Version
  */
@@ -0,0 +1,305 @@
+/* wolfsslBenchFile.c
+ *
+ * Copyright (C) 2006-2015 wolfSSL Inc.
+ *
+ * This file is part of wolfSSL. (formerly known as CyaSSL)
+ *
+ * wolfSSL is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfSSL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "include/wolfssl.h"
+
+#define BENCH_FILE_PWD "wolfssl benchmark"  /* password the file is under */
+#define BENCH_FILE_NAME 256                 /* room for the test file names */
+
+#if !defined(NO_AES) && !defined(NO_SHA256) && !defined(NO_PWDBASED)
+
+/* the files one run works on */
+typedef struct WolfsslBenchFiles {
+    char    plain[BENCH_FILE_NAME];     /* generated input */
+    char    enc[BENCH_FILE_NAME + 4];   /* plain encrypted */
+    char    dec[BENCH_FILE_NAME + 4];   /* enc decrypted again */
+} WolfsslBenchFiles;
+
+/* what one stage of the pipeline took */
+typedef struct WolfsslBenchStage {
+    const char*   name;
+    double        wall;             /* seconds from start to synced output */
+    WolfsslPhases phases;           /* seconds of each phase */
+} WolfsslBenchStage;
+
+/*
+ * writes a file's dirty pages to disk and drops it from the page cache, so
+ * the next stage reads it from the disk rather than from memory
+ */
+static int wolfsslBenchFileFlush(const char* name)
+{
+    int     fd;                 /* the file */
+    int     ret = 0;            /* return variable */
+
+    fd = open(name, O_RDONLY);
+    if (fd < 0)
+        return FREAD_ERROR;
+    if (fdatasync(fd) != 0)
+        ret = FWRITE_ERROR;
+#ifdef POSIX_FADV_DONTNEED
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+    close(fd);
+
+    return ret;
+}
+
+/*
+ * writes size bytes of test data to name and its SHA-256 to digest. The
+ * random chunk is repeated with the chunk's number stamped at its front, so
+ * no two chunks are alike without paying for random data every time
+ */
+static int wolfsslBenchFileMake(const char* name, int64_t size, byte* digest)
+{
+    Sha256  sha;                /* digest of what is written */
+    RNG     rng;                /* fills the chunk */
+    FILE*   out;                /* the test file */
+    byte*   buf;                /* one chunk */
+    int64_t idx;                /* number of this chunk */
+    int64_t pos;                /* bytes written */
+    int     n;                  /* bytes this time */
+    int     ret;                /* return variable */
+
+    buf = wolfsslBufAlloc(DEFAULT_CHUNK);
+    if (buf == NULL)
+        return MEMORY_E;
+
+    ret = wc_InitRng(&rng);
+    if (ret == 0) {
+        ret = wc_RNG_GenerateBlock(&rng, buf, DEFAULT_CHUNK);
+        wc_FreeRng(&rng);
+    }
+    if (ret == 0)
+        ret = wc_InitSha256(&sha);
+    if (ret != 0) {
+        wolfsslBufFree(buf);
+        return ret;
+    }
+
+    out = fopen(name, "wb");
+    if (out == NULL) {
+        wolfsslBufFree(buf);
+        return FWRITE_ERROR;
+    }
+    for (pos = 0, idx = 0; ret == 0 && pos < size; pos += n, idx++) {
+        n = (size - pos < DEFAULT_CHUNK) ? (int)(size - pos) : DEFAULT_CHUNK;
+        XMEMCPY(buf, &idx, n < (int) sizeof(idx) ? n : (int) sizeof(idx));
+        if (fwrite(buf, 1, n, out) != (size_t) n)
+            ret = FWRITE_ERROR;
+        else
+            ret = wc_Sha256Update(&sha, buf, (word32) n);
+    }
+    if (fclose(out) != 0 && ret == 0)
+        ret = FWRITE_ERROR;
+    if (ret == 0)
+        ret = wc_Sha256Final(&sha, digest);
+
+    wolfsslBufFree(buf);
+
+    return ret;
+}
+
+/*
+ * prints one stage's row of the table
+ */
+static void wolfsslBenchFileRow(const WolfsslBenchStage* stage, int64_t size)
+{
+    const double* s = stage->phases.seconds;
+    double  other;              /* time outside the timed phases */
+    int     i;                  /* loop variable */
+
+    other = stage->wall;
+    for (i = 0; i < WOLFSSL_PHASES; i++)
+        other -= s[i];
+    if (other < 0)
+        other = 0;
+
+    printf("%-10s %9.3f %10.1f %9.3f %9.3f %9.3f %9.3f %9.3f\n", stage->name,
+            stage->wall, stage->wall > 0 ? size / stage->wall / MEGABYTE : 0,
+            s[WOLFSSL_PHASE_READ], s[WOLFSSL_PHASE_CRYPTO],
+            s[WOLFSSL_PHASE_WRITE], s[WOLFSSL_PHASE_KDF], other);
+}
+
+/*
+ * runs encrypt, decrypt and hash on the test file, timing each
+ */
+static int wolfsslBenchFileRun(const WolfsslBenchFiles* files, int64_t size,
+                            const byte* digest, WolfsslBenchStage* stages)
+{
+    WolfsslIo io = {DEFAULT_CHUNK, 1, 0, WOLFSSL_IO_SYNC, NULL};
+    byte    pwdKey[256];        /* password, then the key stretched from it */
+    byte    key[256];           /* key the cipher is given */
+    byte    iv[AES_BLOCK_SIZE]; /* generated by encrypt, read by decrypt */
+    byte    output[SHA256_DIGEST_SIZE]; /* digest of the decrypted file */
+    byte*   input;              /* chunk buffer for the hash */
+    char    alg[]  = "aes";     /* wolfsslEncrypt wants these writable */
+    char    mode[] = "cbc";
+    char    in[BENCH_FILE_NAME + 4];
+    char    out[BENCH_FILE_NAME + 4];
+    struct stat st;             /* size of the decrypted file */
+    double  start;              /* start of a stage */
+    double  sync;               /* start of its flush */
+    int     ret;                /* return variable */
+
+    XMEMSET(key, 0, sizeof(key));
+    XMEMSET(iv, 0, sizeof(iv));
+
+    /* encrypt, the same as encrypt -aes-cbc-256 -pwd */
+    XMEMSET(pwdKey, 0, sizeof(pwdKey));
+    XSTRNCPY((char*) pwdKey, BENCH_FILE_PWD, sizeof(pwdKey) - 1);
+    XSTRNCPY(in, files->plain, sizeof(in));
+    XSTRNCPY(out, files->enc, sizeof(out));
+    stages[0].name = "encrypt";
+    io.phases = &stages[0].phases;
+    start = wolfsslGetTime();
+    ret = wolfsslEncrypt(alg, mode, pwdKey, key, 256, in, out, iv,
+                            AES_BLOCK_SIZE, 0, 0, KDF_ITERATIONS, &io);
+    sync = wolfsslGetTime();
+    if (ret == 0)
+        ret = wolfsslBenchFileFlush(files->enc);
+    stages[0].phases.seconds[WOLFSSL_PHASE_WRITE] += wolfsslGetTime() - sync;
+    stages[0].wall = wolfsslGetTime() - start;
+    if (ret != 0) {
+        printf("Failed to encrypt %s\n", files->plain);
+        return ret;
+    }
+
+    /* decrypt, the same as decrypt -aes-cbc-256 -pwd */
+    XMEMSET(pwdKey, 0, sizeof(pwdKey));
+    XSTRNCPY((char*) pwdKey, BENCH_FILE_PWD, sizeof(pwdKey) - 1);
+    XSTRNCPY(in, files->enc, sizeof(in));
+    XSTRNCPY(out, files->dec, sizeof(out));
+    stages[1].name = "decrypt";
+    io.phases = &stages[1].phases;
+    start = wolfsslGetTime();
+    ret = wolfsslDecrypt(alg, mode, pwdKey, key, 256, in, out, iv,
+                                                    AES_BLOCK_SIZE, 1, &io);
+    sync = wolfsslGetTime();
+    if (ret == 0)
+        ret = wolfsslBenchFileFlush(files->dec);
+    stages[1].phases.seconds[WOLFSSL_PHASE_WRITE] += wolfsslGetTime() - sync;
+    stages[1].wall = wolfsslGetTime() - start;
+    XMEMSET(pwdKey, 0, sizeof(pwdKey));
+    if (ret != 0) {
+        printf("Failed to decrypt %s\n", files->enc);
+        return ret;
+    }
+
+    /* hash, the same as hash -sha256, which is also the round trip check */
+    input = wolfsslBufAlloc(io.chunk);
+    if (input == NULL)
+        return MEMORY_E;
+    stages[2].name = "sha256";
+    io.phases = &stages[2].phases;
+    start = wolfsslGetTime();
+    ret = wolfsslHashFile(files->dec, "sha256", SHA256_DIGEST_SIZE, &io,
+                                                            input, output);
+    stages[2].wall = wolfsslGetTime() - start;
+    wolfsslBufFree(input);
+    if (ret != 0) {
+        printf("Failed to hash %s\n", files->dec);
+        return ret;
+    }
+
+    if (stat(files->dec, &st) != 0 || (int64_t) st.st_size != size ||
+                    XMEMCMP(output, digest, SHA256_DIGEST_SIZE) != 0) {
+        printf("Round trip FAILED, %s does not match what was encrypted\n",
+                                                                files->dec);
+        return FATAL_ERROR;
+    }
+
+    return 0;
+}
+
+/*
+ * times the file data paths end to end on a generated file
+ */
+int wolfsslBenchFile(const WolfsslBenchOpts* opts)
+{
+    WolfsslBenchFiles files;        /* names of the test files */
+    WolfsslBenchStage stages[3];    /* encrypt, decrypt and hash */
+    byte    digest[SHA256_DIGEST_SIZE]; /* of the generated file */
+    const char* dir;                /* where the test files go */
+    double  start;                  /* start of generating the file */
+    int     fd;                     /* from mkstemp */
+    int     i;                      /* loop variable */
+    int     ret;                    /* return variable */
+
+    XMEMSET(stages, 0, sizeof(stages));
+
+    dir = getenv("TMPDIR");
+    if (dir == NULL || dir[0] == '\0')
+        dir = "/tmp";
+    if (snprintf(files.plain, sizeof(files.plain), "%s/wolfsslBenchXXXXXX",
+                        dir) >= (int) sizeof(files.plain)) {
+        printf("TMPDIR %s is too long\n", dir);
+        return FATAL_ERROR;
+    }
+    fd = mkstemp(files.plain);
+    if (fd < 0) {
+        printf("Failed to create a test file in %s\n", dir);
+        return FWRITE_ERROR;
+    }
+    close(fd);
+    snprintf(files.enc, sizeof(files.enc), "%s.enc", files.plain);
+    snprintf(files.dec, sizeof(files.dec), "%s.dec", files.plain);
+
+    printf("\nGenerating %.1f MB in %s\n", (double) opts->fileSize / MEGABYTE,
+                                                                files.plain);
+    start = wolfsslGetTime();
+    ret = wolfsslBenchFileMake(files.plain, opts->fileSize, digest);
+    if (ret == 0)
+        ret = wolfsslBenchFileFlush(files.plain);
+    if (ret != 0)
+        printf("Failed to write %s\n", files.plain);
+    else {
+        printf("Generated in %.3f s, timing aes-cbc-256 with %d PBKDF2 "
+               "iterations and sha256 in %d byte chunks\n",
+               wolfsslGetTime() - start, KDF_ITERATIONS, DEFAULT_CHUNK);
+        ret = wolfsslBenchFileRun(&files, opts->fileSize, digest, stages);
+    }
+
+    if (ret == 0) {
+        printf("\n%-10s %9s %10s %9s %9s %9s %9s %9s\n", "Stage", "Wall s",
+               "MB/s", "Read s", "Crypto s", "Write s", "KDF s", "Other s");
+        for (i = 0; i < 3; i++)
+            wolfsslBenchFileRow(&stages[i], opts->fileSize);
+        printf("Round trip OK, the decrypted file matches byte for byte\n");
+    }
+
+    unlink(files.plain);
+    unlink(files.enc);
+    unlink(files.dec);
+
+    return ret;
+}
+
+#else
+
+int wolfsslBenchFile(const WolfsslBenchOpts* opts)
+{
+    (void) opts;
+    printf("-bench file needs aes, sha256 and pwdbased support in wolfSSL\n");
+
+    return FATAL_ERROR;
+}
+
+#endif
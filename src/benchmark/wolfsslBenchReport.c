@@ -0,0 +1,342 @@
+/* wolfsslBenchReport.c
+ *
+ * Copyright (C) 2006-2015 wolfSSL Inc.
+ *
+ * This file is part of wolfSSL. (formerly known as CyaSSL)
+ *
+ * wolfSSL is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfSSL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "include/wolfssl.h"
+#include "include/version.h"
+#include <sys/utsname.h>
+#ifdef HAVE_WOLFSSL_LIB_VERSION
+    #include <wolfssl/ssl.h>
+#endif
+
+/* what the results were measured on */
+typedef struct WolfsslBenchEnv {
+    char    cpu[128];           /* processor model */
+    long    cpus;               /* online processors */
+    char    system[160];        /* kernel name and release */
+    char    machine[80];        /* architecture */
+    const char* wolfssl;        /* library version */
+} WolfsslBenchEnv;
+
+/*
+ * fills in the processor model, from /proc/cpuinfo where there is one
+ */
+static void wolfsslBenchEnvGet(WolfsslBenchEnv* env)
+{
+    struct utsname un;          /* kernel and architecture */
+    FILE*   in;                 /* /proc/cpuinfo */
+    char    line[256];          /* one line of it */
+    char*   value;              /* what follows the ':' */
+    size_t  len;
+
+    XMEMSET(env, 0, sizeof(WolfsslBenchEnv));
+    env->cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#ifdef HAVE_WOLFSSL_LIB_VERSION
+    env->wolfssl = wolfSSL_lib_version();
+#else
+    env->wolfssl = "unknown";
+#endif
+
+    if (uname(&un) == 0) {
+        snprintf(env->system, sizeof(env->system), "%s %s", un.sysname,
+                                                                un.release);
+        snprintf(env->machine, sizeof(env->machine), "%s", un.machine);
+    }
+
+    in = fopen("/proc/cpuinfo", "r");
+    if (in != NULL) {
+        while (fgets(line, sizeof(line), in) != NULL) {
+            if (strncmp(line, "model name", 10) != 0 &&
+                                        strncmp(line, "Hardware", 8) != 0)
+                continue;
+            value = strchr(line, ':');
+            if (value == NULL)
+                continue;
+            for (value++; *value == ' ' || *value == '\t'; value++)
+                ;
+            len = strlen(value);
+            while (len > 0 && (value[len-1] == '\n' || value[len-1] == ' '))
+                value[--len] = '\0';
+            snprintf(env->cpu, sizeof(env->cpu), "%s", value);
+            break;
+        }
+        fclose(in);
+    }
+    if (env->cpu[0] == '\0')
+        snprintf(env->cpu, sizeof(env->cpu), "%s", env->machine);
+}
+
+/*
+ * prints str in double quotes, escaped for JSON or else for CSV
+ */
+static void wolfsslBenchQuote(const char* str, int json)
+{
+    putchar('"');
+    for (; *str != '\0'; str++) {
+        if (*str == '"')
+            putchar(json ? '\\' : '"');
+        else if (*str == '\\' && json)
+            putchar('\\');
+        putchar(*str);
+    }
+    putchar('"');
+}
+
+/*
+ * keeps a copy of one result
+ */
+int wolfsslBenchAdd(WolfsslBenchResults* results,
+                                            const WolfsslBenchResult* result)
+{
+    WolfsslBenchResult* list;   /* grown list */
+    int     cap;                /* its room */
+
+    if (results->count == results->cap) {
+        cap  = (results->cap == 0) ? 16 : results->cap * 2;
+        list = (WolfsslBenchResult*) realloc(results->list,
+                                            cap * sizeof(WolfsslBenchResult));
+        if (list == NULL)
+            return MEMORY_E;
+        results->list = list;
+        results->cap  = cap;
+    }
+    results->list[results->count++] = *result;
+
+    return 0;
+}
+
+/*
+ * prints the results as JSON or CSV
+ */
+void wolfsslBenchReport(const WolfsslBenchResults* results, int format)
+{
+    WolfsslBenchEnv env;        /* what they were measured on */
+    const WolfsslBenchResult* r;
+    int     json = (format == WOLFSSL_BENCH_JSON);
+    int     i, j;               /* loop variables */
+
+    wolfsslBenchEnvGet(&env);
+
+    if (format == WOLFSSL_BENCH_CSV) {
+        printf("algorithm,operation,key_size,buffer_size,threads,mbs,ops,"
+               "min,mean,stddev,p95,cycles_per_byte,p50_ns,p90_ns,p99_ns,"
+               "p999_ns,max_ns,cpu,cpus,system,machine,wolfssl,clu\n");
+        for (i = 0; i < results->count; i++) {
+            r = &results->list[i];
+            wolfsslBenchQuote(r->name, json);
+            printf(",%s,%d,%d,%d,%.2f,%.1f,%.2f,%.2f,%.2f,%.2f,%.3f,", r->op,
+                        r->keySz, r->size, r->threads, r->mbs, r->ops, r->min,
+                        r->mean, r->stddev, r->p95, r->cpb);
+            for (j = 0; j < BENCH_LATENCIES; j++)
+                printf("%.0f,", r->latency[j]);
+            wolfsslBenchQuote(env.cpu, json);
+            printf(",%ld,", env.cpus);
+            wolfsslBenchQuote(env.system, json);
+            printf(",%s,%s,%s\n", env.machine, env.wolfssl,
+                                                    LIBWOLFSSL_VERSION_STRING);
+        }
+        return;
+    }
+
+    printf("{\n  \"environment\": {\"cpu\": ");
+    wolfsslBenchQuote(env.cpu, json);
+    printf(", \"cpus\": %ld, \"system\": ", env.cpus);
+    wolfsslBenchQuote(env.system, json);
+    printf(", \"machine\": ");
+    wolfsslBenchQuote(env.machine, json);
+    printf(", \"wolfssl\": ");
+    wolfsslBenchQuote(env.wolfssl, json);
+    printf(", \"clu\": \"%s\"},\n", LIBWOLFSSL_VERSION_STRING);
+    printf("  \"results\": [\n");
+    for (i = 0; i < results->count; i++) {
+        r = &results->list[i];
+        /* one object per line, wolfsslBenchCompare reads them back so */
+        printf("    {\"algorithm\": ");
+        wolfsslBenchQuote(r->name, json);
+        printf(", \"operation\": \"%s\", \"key_size\": %d, "
+               "\"buffer_size\": %d, \"threads\": %d, \"mbs\": %.2f, "
+               "\"ops\": %.1f, \"min\": %.2f, \"mean\": %.2f, "
+               "\"stddev\": %.2f, \"p95\": %.2f, \"cycles_per_byte\": %.3f",
+               r->op, r->keySz, r->size, r->threads, r->mbs, r->ops, r->min,
+               r->mean, r->stddev, r->p95, r->cpb);
+        if (r->latency[BENCH_LATENCIES-1] > 0)
+            printf(", \"p50_ns\": %.0f, \"p90_ns\": %.0f, \"p99_ns\": %.0f, "
+                   "\"p999_ns\": %.0f, \"max_ns\": %.0f", r->latency[0],
+                   r->latency[1], r->latency[2], r->latency[3], r->latency[4]);
+        printf("}%s\n", i + 1 < results->count ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+/*
+ * finds "key": in line and returns what follows, NULL without it
+ */
+static const char* wolfsslBenchJsonValue(const char* line, const char* key)
+{
+    char    pattern[40];        /* "key": */
+    const char* at;
+
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    at = strstr(line, pattern);
+    if (at == NULL)
+        return NULL;
+    for (at += strlen(pattern); *at == ' '; at++)
+        ;
+
+    return at;
+}
+
+/*
+ * reads one result object of a -format json line back
+ */
+static int wolfsslBenchJsonResult(const char* line, WolfsslBenchResult* r)
+{
+    const char* v;              /* value of one key */
+    size_t      n = 0;          /* characters of the name */
+
+    XMEMSET(r, 0, sizeof(WolfsslBenchResult));
+
+    v = wolfsslBenchJsonValue(line, "algorithm");
+    if (v == NULL || *v++ != '"')
+        return FATAL_ERROR;
+    while (v[n] != '"' && v[n] != '\0' && n + 1 < sizeof(r->name)) {
+        r->name[n] = v[n];
+        n++;
+    }
+
+    v = wolfsslBenchJsonValue(line, "operation");
+    if (v == NULL || *v++ != '"')
+        return FATAL_ERROR;
+    for (n = 0; v[n] != '"' && v[n] != '\0' && n + 1 < sizeof(r->op); n++)
+        r->op[n] = v[n];
+
+    if ((v = wolfsslBenchJsonValue(line, "key_size")) == NULL)
+        return FATAL_ERROR;
+    r->keySz = atoi(v);
+    if ((v = wolfsslBenchJsonValue(line, "buffer_size")) == NULL)
+        return FATAL_ERROR;
+    r->size = atoi(v);
+    if ((v = wolfsslBenchJsonValue(line, "threads")) == NULL)
+        return FATAL_ERROR;
+    r->threads = atoi(v);
+    if ((v = wolfsslBenchJsonValue(line, "mbs")) == NULL)
+        return FATAL_ERROR;
+    r->mbs = strtod(v, NULL);
+    if ((v = wolfsslBenchJsonValue(line, "ops")) == NULL)
+        return FATAL_ERROR;
+    r->ops = strtod(v, NULL);
+    /* only -latency results have it */
+    if ((v = wolfsslBenchJsonValue(line, "p99_ns")) != NULL)
+        r->latency[2] = strtod(v, NULL);
+
+    return 0;
+}
+
+/*
+ * compares results with a file -format json wrote earlier
+ */
+int wolfsslBenchCompare(const WolfsslBenchResults* results,
+                        const char* baseline, double threshold, FILE* out)
+{
+    WolfsslBenchResults base;   /* the baseline's results */
+    WolfsslBenchResult  r;      /* one read back */
+    const WolfsslBenchResult* cur;
+    const WolfsslBenchResult* old;
+    FILE*   in;                 /* the baseline file */
+    char*   line   = NULL;      /* one line, grown by getline */
+    size_t  lineSz = 0;         /* allocated size of line */
+    double  now, then;          /* MB/s, or key setups/s, of each */
+    double  change;             /* percent faster, negative when slower */
+    int     latency;            /* 1 to compare p99 latencies */
+    int     regressed = 0;      /* results slower than threshold */
+    int     i, j;               /* loop variables */
+    int     ret = 0;            /* return variable */
+
+    XMEMSET(&base, 0, sizeof(base));
+
+    in = fopen(baseline, "r");
+    if (in == NULL) {
+        printf("Failed to open baseline %s\n", baseline);
+        return FREAD_ERROR;
+    }
+    while (ret == 0 && getline(&line, &lineSz, in) > 0) {
+        if (strstr(line, "\"algorithm\"") != NULL &&
+                                        wolfsslBenchJsonResult(line, &r) == 0)
+            ret = wolfsslBenchAdd(&base, &r);
+    }
+    free(line);
+    fclose(in);
+    if (ret != 0) {
+        wolfsslBenchResultsFree(&base);
+        return ret;
+    }
+
+    fprintf(out, "\nCompared with %s, failing more than %.1f%% slower\n",
+                                                        baseline, threshold);
+    for (i = 0; i < results->count; i++) {
+        cur = &results->list[i];
+        old = NULL;
+        for (j = 0; j < base.count && old == NULL; j++) {
+            if (strcmp(base.list[j].name, cur->name) == 0 &&
+                        strcmp(base.list[j].op, cur->op) == 0 &&
+                        base.list[j].keySz == cur->keySz &&
+                        base.list[j].size == cur->size &&
+                        base.list[j].threads == cur->threads)
+                old = &base.list[j];
+        }
+
+        /* latency is compared at p99, where lower is better */
+        latency = cur->latency[2] > 0;
+        now = latency ? cur->latency[2] : cur->size > 0 ? cur->mbs : cur->ops;
+        fprintf(out, "%-10s %-8s key %3d, %8d bytes, %2d threads: %10.1f %s",
+                cur->name, cur->op, cur->keySz, cur->size, cur->threads, now,
+                latency ? "ns p99" : cur->size > 0 ? "MB/s" : "keys/s");
+        then = (old == NULL) ? 0 : latency ? old->latency[2] :
+                                    old->size > 0 ? old->mbs : old->ops;
+        if (then <= 0) {
+            fprintf(out, ", not in baseline\n");
+            continue;
+        }
+        change = latency ? 100.0 * (then - now) / then :
+                           100.0 * (now - then) / then;
+        fprintf(out, ", baseline %10.1f, %+6.1f%%%s\n", then, change,
+                                -change > threshold ? "  REGRESSION" : "");
+        if (-change > threshold)
+            regressed++;
+    }
+    if (regressed > 0)
+        fprintf(out, "%d of %d results regressed\n", regressed,
+                                                            results->count);
+    else
+        fprintf(out, "No regressions\n");
+
+    wolfsslBenchResultsFree(&base);
+
+    return regressed > 0 ? BENCH_REGRESSION : 0;
+}
+
+/*
+ * frees the list of results
+ */
+void wolfsslBenchResultsFree(WolfsslBenchResults* results)
+{
+    free(results->list);
+    XMEMSET(results, 0, sizeof(WolfsslBenchResults));
+}
@@ -21,46 +21,85 @@
 
 #include "include/wolfssl.h"
 
+/* sizes -sizes sweeps when it isn't given a list */
+static const int defaultSizes[] = {16, 64, 256, 1024, 8192, 16384, 65536,
+                                   MEGABYTE};
+
+/* message sizes -latency times without -sizes, small requests */
+static const int latencySizes[] = {1024, 2048, 4096};
+
+/*
+ * reads a -sizes list such as 16,64,1k,1m into opts
+ */
+static int wolfsslBenchParseSizes(const char* list, WolfsslBenchOpts* opts)
+{
+    char    buf[256];           /* list split at its commas */
+    char*   tok;                /* one size */
+    char*   save = NULL;        /* strtok_r state */
+    int64_t size;               /* parsed size */
+
+    if (strlen(list) >= sizeof(buf))
+        return FATAL_ERROR;
+    XSTRNCPY(buf, list, sizeof(buf));
+
+    opts->sizeCount = 0;
+    for (tok = strtok_r(buf, ",", &save); tok != NULL;
+                                        tok = strtok_r(NULL, ",", &save)) {
+        if (opts->sizeCount == MAX_BENCH_SIZES ||
+                    wolfsslParseSize(tok, &size) != 0 || size < 1 ||
+                    size > MAX_CHUNK)
+            return FATAL_ERROR;
+        opts->sizes[opts->sizeCount++] = (int) size;
+    }
+
+    return opts->sizeCount > 0 ? 0 : FATAL_ERROR;
+}
+
+/*
+ * reads a -ops list such as encrypt,keysetup into opts
+ */
+static int wolfsslBenchParseOps(const char* list, WolfsslBenchOpts* opts)
+{
+    char    buf[64];            /* list split at its commas */
+    char*   tok;                /* one operation */
+    char*   save = NULL;        /* strtok_r state */
+
+    if (strlen(list) >= sizeof(buf))
+        return FATAL_ERROR;
+    XSTRNCPY(buf, list, sizeof(buf));
+
+    opts->ops = 0;
+    for (tok = strtok_r(buf, ",", &save); tok != NULL;
+                                        tok = strtok_r(NULL, ",", &save)) {
+        if (XSTRNCMP(tok, "encrypt", XSTRLEN(tok)) == 0)
+            opts->ops |= WOLFSSL_BENCH_ENCRYPT;
+        else if (XSTRNCMP(tok, "decrypt", XSTRLEN(tok)) == 0)
+            opts->ops |= WOLFSSL_BENCH_DECRYPT;
+        else if (XSTRNCMP(tok, "keysetup", XSTRLEN(tok)) == 0)
+            opts->ops |= WOLFSSL_BENCH_KEYSETUP;
+        else
+            return FATAL_ERROR;
+    }
+
+    return opts->ops != 0 ? 0 : FATAL_ERROR;
+}
+
 int wolfsslBenchSetup(int argc, char** argv)
 {
     int     ret     =   0;          /* return variable */
-    int     time    =   3;          /* timer variable */
     int     i, j    =   0;          /* second loop variable */
-    const char*   algs[]  =   {     /* list of acceptable algorithms */
-#ifndef NO_AES
-        "aes-cbc"
-#endif
-#ifdef WOLFSSL_AES_COUNTER
-            , "aes-ctr"
-#endif
-#ifndef NO_DES3
-            , "3des"
-#endif
-#ifdef HAVE_CAMELLIA
-            , "camellia"
-#endif
-#ifndef NO_MD5
-            , "md5"
-#endif
-#ifndef NO_SHA
-            , "sha"
-#endif
-#ifndef NO_SHA256
-            , "sha256"
-#endif
-#ifdef WOLFSSL_SHA384
-            , "sha384"
-#endif
-#ifdef WOLFSSL_SHA512
-            , "sha512"
-#endif
-#ifdef HAVE_BLAKE2
-            , "blake2b"
-#endif
-    };
+    WolfsslBenchOpts opts;          /* time and sizes of each test */
+    const char* name;               /* of one benchmark in the table */
+
+    int option[MAX_BENCH_CASES] = {0};  /* benchmarks to run */
+    int optionCheck = 0;                /* acceptable option check */
 
-    int option[sizeof(algs)/sizeof(algs[0])] = {0};/* acceptable options */
-    int optionCheck = 0;                           /* acceptable option check */
+    XMEMSET(&opts, 0, sizeof(opts));
+    opts.time = 3;
+    opts.reps = 1;
+    opts.threshold = 10;
+    opts.ops = WOLFSSL_BENCH_ALLOPS;
+    opts.fileSize = BENCH_FILE_SIZE;
 
     for (i = 2; i < argc; i++) {
         if (XSTRNCMP(argv[i], "-help", 5) == 0) {
@@ -68,39 +107,165 @@ int wolfsslBenchSetup(int argc, char** argv)
             wolfsslBenchHelp();
             return 0;
         }
-        for (j = 0; j < (int) sizeof(algs)/(int) sizeof(algs[0]); j++) {
+        for (j = 0; (name = wolfsslBenchName(j)) != NULL; j++) {
             /* checks for individual tests in the arguments */
-            if (XSTRNCMP(argv[i], algs[j], XSTRLEN(argv[i])) == 0) {
+            if (XSTRNCMP(argv[i], name, XSTRLEN(argv[i])) == 0) {
                 option[j] = 1;
                 optionCheck = 1;
             }
         }
+        if (XSTRNCMP(argv[i], "file", 5) == 0) {
+            /* the real encrypt, decrypt and hash paths on a generated file */
+            opts.file = 1;
+            optionCheck = 1;
+        }
+        if (XSTRNCMP(argv[i], "-size", 6) == 0 && argv[i+1] != NULL) {
+            /* bytes in the -bench file test file */
+            if (wolfsslParseSize(argv[i+1], &opts.fileSize) != 0 ||
+                                                        opts.fileSize < 1) {
+                printf("Invalid file size, must be a positive size with an "
+                       "optional k, m or g suffix.\n");
+                return FATAL_ERROR;
+            }
+            i++;
+        }
         if (XSTRNCMP(argv[i], "-time", 5) == 0 && argv[i+1] != NULL) {
             /* time for each test in seconds */
-            time = atoi(argv[i+1]);
-            if (time < 1 || time > 10) {
+            opts.time = atoi(argv[i+1]);
+            if (opts.time < 1 || opts.time > 10) {
                 printf("Invalid time, must be between 1-10. Using default"
                                                 " of three seconds.\n");
-                time = 3;
+                opts.time = 3;
+            }
+            i++;
+        }
+        if (XSTRNCMP(argv[i], "-sizes", 6) == 0) {
+            /* bytes per call to sweep, a default sweep without a list */
+            if (i + 1 < argc && argv[i+1][0] != '-') {
+                if (wolfsslBenchParseSizes(argv[i+1], &opts) != 0) {
+                    printf("Invalid sizes, must be up to %d comma separated "
+                           "sizes between 1 and %d.\n", MAX_BENCH_SIZES,
+                           MAX_CHUNK);
+                    return FATAL_ERROR;
+                }
+                i++;
+            }
+            else {
+                opts.sizeCount = sizeof(defaultSizes)/sizeof(defaultSizes[0]);
+                XMEMCPY(opts.sizes, defaultSizes, sizeof(defaultSizes));
+            }
+        }
+        if (XSTRNCMP(argv[i], "-threads", 8) == 0 && argv[i+1] != NULL) {
+            /* N runs on 1 thread then N, 1..N doubles from 1 up to N */
+            opts.threadSweep = XSTRNCMP(argv[i+1], "1..", 3) == 0;
+            opts.threads = atoi(argv[i+1] + (opts.threadSweep ? 3 : 0));
+            if (opts.threads < 1 || opts.threads > MAX_THREADS) {
+                printf("Invalid thread count, must be N or 1..N with N "
+                       "between 1-%d.\n", MAX_THREADS);
+                return FATAL_ERROR;
+            }
+#ifndef HAVE_PTHREAD
+            printf("Built without thread support, ignoring -threads\n");
+            opts.threads = 0;
+#endif
+            i++;
+        }
+        if (XSTRNCMP(argv[i], "-reps", 5) == 0 && argv[i+1] != NULL) {
+            /* timed runs of each test, for the spread between them */
+            opts.reps = atoi(argv[i+1]);
+            if (opts.reps < 1 || opts.reps > MAX_BENCH_REPS) {
+                printf("Invalid repetitions, must be between 1-%d.\n",
+                                                            MAX_BENCH_REPS);
+                return FATAL_ERROR;
+            }
+            i++;
+        }
+        if (XSTRNCMP(argv[i], "-format", 7) == 0 && argv[i+1] != NULL) {
+            /* text, or json or csv for other programs to read */
+            if (XSTRNCMP(argv[i+1], "text", 5) == 0)
+                opts.format = WOLFSSL_BENCH_TEXT;
+            else if (XSTRNCMP(argv[i+1], "json", 5) == 0)
+                opts.format = WOLFSSL_BENCH_JSON;
+            else if (XSTRNCMP(argv[i+1], "csv", 4) == 0)
+                opts.format = WOLFSSL_BENCH_CSV;
+            else {
+                printf("Invalid format, must be text, json or csv.\n");
+                return FATAL_ERROR;
+            }
+            i++;
+        }
+        if (XSTRNCMP(argv[i], "-baseline", 9) == 0 && argv[i+1] != NULL) {
+            /* results of an earlier -format json run to compare with */
+            opts.baseline = argv[i+1];
+            if (access(opts.baseline, R_OK) != 0) {
+                /* before the tests rather than after */
+                printf("Failed to open baseline %s\n", opts.baseline);
+                return FREAD_ERROR;
             }
             i++;
         }
+        if (XSTRNCMP(argv[i], "-threshold", 10) == 0 && argv[i+1] != NULL) {
+            /* percent slower than the baseline that counts as a regression */
+            opts.threshold = atof(argv[i+1]);
+            if (opts.threshold <= 0 || opts.threshold >= 100) {
+                printf("Invalid threshold, must be a percentage between "
+                       "0-100.\n");
+                return FATAL_ERROR;
+            }
+            i++;
+        }
+        if (XSTRNCMP(argv[i], "-ops", 4) == 0 && argv[i+1] != NULL) {
+            /* cipher operations to time */
+            if (wolfsslBenchParseOps(argv[i+1], &opts) != 0) {
+                printf("Invalid operations, must be a comma separated list "
+                       "of encrypt, decrypt and keysetup.\n");
+                return FATAL_ERROR;
+            }
+            i++;
+        }
+        if (XSTRNCMP(argv[i], "-latency", 8) == 0) {
+            /* nanoseconds of each call rather than MB/s */
+            opts.latency = 1;
+        }
         if (XSTRNCMP(argv[i], "-all", 4) == 0) {
             /* perform all available tests */
-            for (j = 0; j < (int) sizeof(algs)/(int) sizeof(algs[0]); j++) {
+            for (j = 0; wolfsslBenchName(j) != NULL; j++) {
                 option[j] = 1;
                 optionCheck = 1;
             }
         }
     }
+    if (opts.latency && opts.sizeCount == 0) {
+        opts.sizeCount = sizeof(latencySizes)/sizeof(latencySizes[0]);
+        XMEMCPY(opts.sizes, latencySizes, sizeof(latencySizes));
+    }
     if (optionCheck != 1) {
         /* help checking */
         wolfsslHelp();
     }
     else {
+        for (j = 0; wolfsslBenchName(j) != NULL; j++) {
+            if (option[j] == 1)
+                break;
+        }
+        if (opts.file == 1) {
+            /* end to end first, then any algorithms also asked for */
+            ret = wolfsslBenchFile(&opts);
+            if (ret != 0 || wolfsslBenchName(j) == NULL)
+                return ret;
+        }
         /* benchmarking function */
-        printf("\nTesting for %d second(s)\n", time);
-        ret = wolfsslBenchmark(time, option);
+        if (opts.format == WOLFSSL_BENCH_TEXT) {
+            printf("\nTesting for %d second(s)", opts.time);
+            if (opts.sizeCount > 0)
+                printf(" at each of %d sizes", opts.sizeCount);
+            if (opts.threads > 0)
+                printf(" on up to %d pinned threads", opts.threads);
+            if (opts.reps > 1)
+                printf(", %d times", opts.reps);
+            printf("\n");
+        }
+        ret = wolfsslBenchmark(&opts, option);
     }
     return ret;
 }
@@ -19,407 +19,1077 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
  */
 
+#ifdef __linux__
+    #define _GNU_SOURCE         /* sched_setaffinity */
+    #include <sched.h>
+#endif
+
 #include "include/wolfssl.h"
+#include <math.h>
 
 #define DES3_BLOCK_SIZE 24
+#define TIMER_SHARE 1000        /* a batch takes this many timer reads */
+#define BENCH_WARMUP 0.25       /* untimed seconds before every run */
+#define BENCH_NOISY 5.0         /* coefficient of variation worth a warning */
 
-#ifdef HAVE_BLAKE2
+/* key sizes wolfsslGetAlgo accepts, in bits, and how many there are */
+#if !defined(NO_AES) || defined(HAVE_CAMELLIA)
+static const int blockKeys[] = {128, 192, 256};     /* aes and camellia */
+#endif
+#ifndef NO_DES3
+static const int des3Keys[]  = {56, 112, 168};
+#endif
+#define BENCH_KEYS(k) (k), (int) (sizeof(k) / sizeof((k)[0]))
+
+#ifndef NO_PWDBASED
+/* PBKDF2 iteration counts timed, around the KDF_ITERATIONS default */
+static const int kdfIterations[] = {KDF_MIN_ITERATIONS, KDF_ITERATIONS,
+                                    10000, 100000};
+#endif
+
+/* percentiles -latency reports, the max last */
+static const double benchLatencies[BENCH_LATENCIES] = {50, 90, 99, 99.9, 100};
+
+/* what one timed run measured */
+typedef struct WolfsslBenchRun {
+    double   seconds;           /* time the calls took */
+    uint64_t cycles;            /* time stamp counter ticks, 0 if unknown */
+    int64_t  blocks;            /* calls made */
+} WolfsslBenchRun;
+
+/* shortest time worth reading the clock after, set by wolfsslBenchmark */
+static double batchTime;
+
+/* results that varied more than BENCH_NOISY percent between -reps */
+static int noisy;
+
+/* every result of this run, for -format and -baseline */
+static WolfsslBenchResults results;
+
+/* MB/s, or keys/s, over every -reps run of one benchmark */
+typedef struct WolfsslBenchSummary {
+    double   min;               /* slowest run */
+    double   median;
+    double   mean;
+    double   stddev;            /* sample standard deviation */
+    double   p95;               /* 95th percentile */
+    double   cv;                /* stddev as a percent of mean */
+    double   slowest;           /* slowest single thread of any run */
+    double   cpb;               /* median cycles/byte, 0 if unknown */
+    WolfsslBenchRun last;       /* the last run, for wolfsslStats */
+} WolfsslBenchSummary;
+
+/* one benchmarked call, sz bytes from in to out. ctx is the worker */
+typedef int (*WolfsslBenchFunc)(void* ctx, byte* out, const byte* in,
+                                                                    word32 sz);
+
+/* one benchmark, enough for each worker to set up a context of its own */
+typedef struct WolfsslBenchTest {
+    const struct WolfsslBenchCase* bench;   /* the table entry it is from */
+    char        name[32];       /* printed name, "AES-CBC-256 decrypt" */
+    const char* algName;        /* name in the results, "AES-CBC" */
+    int         size;           /* bytes per call without -sizes, 0 when
+                                 * timing key setups */
+    int         keySz;          /* key bits, 0 for a hash */
+    int         iterations;     /* PBKDF2 count of a 'p' test */
+    char        action;         /* 'e', 'd', 'k' for key setup, 'h' for a
+                                 * hash or 'p' for PBKDF2 */
+    WolfsslBenchFunc op;        /* the call timed */
+} WolfsslBenchTest;
+
+#ifdef HAVE_PTHREAD
+/* lets workers start their timed loops together */
+typedef struct WolfsslBenchGate {
+    pthread_mutex_t lock;       /* guards waiting and count */
+    pthread_cond_t  cond;       /* signalled when everyone is waiting */
+    int             waiting;    /* workers set up */
+    int             count;      /* workers to wait for */
+} WolfsslBenchGate;
+#endif
+
+/* one thread's part of a benchmark, with a context and buffers of its own */
+typedef struct WolfsslBenchWorker {
+    const WolfsslBenchTest* test;   /* what to run */
+    double           warmup;    /* seconds to run untimed first */
+    int              timer;     /* seconds to run for */
+    int              sz;        /* bytes per call */
+    int              cpu;       /* processor to pin to */
+    WolfsslCipher    cipher;    /* context of a cipher test */
+    WolfsslDigest    digest;    /* context of a hash test */
+    byte             key[MAX_KEY_SIZE]; /* random key */
+    byte             iv[AES_BLOCK_SIZE];  /* random IV */
+    byte*            in;        /* random input */
+    byte*            out;       /* cipher output */
+    int              max;       /* size of in and out */
+    WolfsslBenchRun  run;       /* what the timed loop measured */
+    WolfsslHistogram* hist;     /* latency of each call with -latency */
+    int              ret;       /* how it went */
+#ifdef HAVE_PTHREAD
+    WolfsslBenchGate* gate;     /* shared start, NULL on this thread */
+#endif
+    WolfsslTask      task;      /* the worker on the pool */
+} WolfsslBenchWorker;
 
-#endif /* HAVE_BLAKE2 */
+/* one entry of the benchmark table, everything -bench knows about it */
+typedef struct WolfsslBenchCase {
+    const char* name;           /* as -bench selects it, "aes-cbc" */
+    const char* title;          /* in the output and results, "AES-CBC" */
+    const char* alg;            /* for wolfsslCipherInit/wolfsslDigestInit */
+    const char* mode;           /* cipher mode, NULL for the others */
+    int         block;          /* bytes per call are a multiple of this */
+    int         size;           /* bytes per call without -sizes */
+    int         digestSz;       /* digest size of a hash */
+    const int*  keys;           /* key bits, or PBKDF2 counts, to run at */
+    int         keyCount;
+    int       (*setup)(WolfsslBenchWorker* w);      /* readies a context */
+    WolfsslBenchFunc op;                            /* the call timed */
+    void      (*teardown)(WolfsslBenchWorker* w);   /* clears the context */
+    int       (*run)(const struct WolfsslBenchCase* bench,
+                        const WolfsslBenchOpts* opts);  /* all of its tests */
+} WolfsslBenchCase;
+
+/* keys the cipher and sets its IV, as a new message would */
+static int wolfsslBenchCipherSetup(WolfsslBenchWorker* w)
+{
+    const WolfsslBenchCase* bench = w->test->bench;
+
+    return wolfsslCipherInitEx(&w->cipher, bench->alg, bench->mode, w->key,
+                    w->test->keySz, w->iv, bench->block,
+                    w->test->action == 'd' ? 'd' : 'e');
+}
+
+static void wolfsslBenchCipherTeardown(WolfsslBenchWorker* w)
+{
+    wolfsslCipherFree(&w->cipher);
+}
+
+static int wolfsslBenchCipherOp(void* ctx, byte* out, const byte* in,
+                                                                    word32 sz)
+{
+    WolfsslBenchWorker* w = (WolfsslBenchWorker*) ctx;
+
+    return wolfsslCipherUpdate(&w->cipher, out, in, sz);
+}
+
+/* sets the key schedule and IV again, as a new message would */
+static int wolfsslBenchKeyOp(void* ctx, byte* out, const byte* in, word32 sz)
+{
+    (void) out;
+    (void) in;
+    (void) sz;
+    return wolfsslBenchCipherSetup((WolfsslBenchWorker*) ctx);
+}
+
+#ifndef NO_PWDBASED
+/* derives a key from a password, as encrypting with -pwd does */
+static int wolfsslBenchKdfOp(void* ctx, byte* out, const byte* in, word32 sz)
+{
+    static const byte pwd[] = "Thi$i$myPa$$w0rd";
+    WolfsslBenchWorker* w = (WolfsslBenchWorker*) ctx;
+
+    (void) out;
+    (void) in;
+    return wc_PBKDF2(w->key, pwd, (int) sizeof(pwd) - 1, w->iv,
+                    (int) sizeof(w->iv), w->test->iterations,
+                    KDF_KEY_SIZE(w->test->keySz), SHA256);
+}
+#endif
+
+static int wolfsslBenchDigestSetup(WolfsslBenchWorker* w)
+{
+    return wolfsslDigestInit(&w->digest, w->test->bench->alg,
+                                                    w->test->bench->digestSz);
+}
+
+/* finishes the digest, if it was started, and clears it */
+static void wolfsslBenchDigestTeardown(WolfsslBenchWorker* w)
+{
+    byte digest[MAX_DIGEST_SIZE];   /* message digest */
+
+    if (w->digest.final != NULL) {
+        wolfsslDigestFinal(&w->digest, digest);
+        XMEMSET(digest, 0, sizeof(digest));
+    }
+    wolfsslDigestFree(&w->digest);
+}
+
+static int wolfsslBenchDigestOp(void* ctx, byte* out, const byte* in,
+                                                                    word32 sz)
+{
+    WolfsslBenchWorker* w = (WolfsslBenchWorker*) ctx;
+
+    (void) out;
+    return wolfsslDigestUpdate(&w->digest, in, sz);
+}
 
 /*
- * benchmarking funciton 
+ * handles one message of sz bytes from scratch, the whole cost of a small
+ * request: the context is set up, the call made and the context torn down,
+ * so a cipher is keyed and given its IV and a hash started and finished
  */
-int wolfsslBenchmark(int timer, int* option)
+static int wolfsslBenchMessageOp(void* ctx, byte* out, const byte* in,
+                                                                    word32 sz)
 {
-    int i              =   0;       /* A looping variable */
+    WolfsslBenchWorker* w = (WolfsslBenchWorker*) ctx;
+    const WolfsslBenchCase* bench = w->test->bench;
+    int     ret = 0;            /* return variable */
 
-    int     loop       =   1;       /* benchmarking loop */
-    int64_t blocks     =   0;       /* blocks used during benchmarking */
-#ifndef NO_AES
-    Aes aes;                        /* aes declaration */
+    /* key setups and derivations are whole messages already */
+    if (w->test->size == 0)
+        return w->test->op(w, out, in, sz);
+
+    if (bench->setup != NULL)
+        ret = bench->setup(w);
+    if (ret == 0)
+        ret = w->test->op(w, out, in, sz);
+    if (bench->teardown != NULL)
+        bench->teardown(w);
+
+    return ret;
+}
+
+/*
+ * how long reading the clock takes, or its resolution if that is coarser
+ */
+static double wolfsslBenchTimerCost(void)
+{
+    struct timespec res;        /* clock resolution */
+    double  start;              /* first read */
+    double  cost;               /* one read */
+    int     n;                  /* loop variable */
+
+    start = wolfsslGetTime();
+    for (n = 0; n < 1000; n++)
+        cost = wolfsslGetTime();
+    cost = (cost - start) / 1000;
+
+    if (clock_getres(CLOCK_MONOTONIC, &res) == 0 &&
+                    (double)res.tv_sec + (double)res.tv_nsec / 1e9 > cost)
+        cost = (double)res.tv_sec + (double)res.tv_nsec / 1e9;
+
+    return cost;
+}
+
+/*
+ * calls op on sz bytes until timer seconds have gone by. The clock is
+ * only read between batches of calls, and batches double until one takes
+ * TIMER_SHARE times as long as a clock read, keeping the timer under 0.1%
+ * of what is measured.
+ */
+static int wolfsslBenchLoop(double timer, WolfsslBenchFunc op, void* ctx,
+                    byte* out, const byte* in, int sz, WolfsslBenchRun* run)
+{
+    int64_t  batch = 1;         /* calls between clock reads */
+    int64_t  n;                 /* calls made this batch */
+    double   start;             /* start time */
+    double   last;              /* clock at the start of this batch */
+    double   now;               /* clock at the end of it */
+    uint64_t cycles;            /* counter at start */
+    int      ret   = 0;         /* return variable */
+
+    run->blocks = 0;
+    cycles = wolfsslCycles();
+    start  = last = wolfsslGetTime();
+
+    for (;;) {
+        for (n = 0; n < batch && ret == 0; n++)
+            ret = op(ctx, out, in, (word32) sz);
+        run->blocks += n;
+        now = wolfsslGetTime();
+        if (ret != 0 || now - start >= timer)
+            break;
+        if (now - last < batchTime)
+            batch *= 2;
+        last = now;
+    }
+
+    run->seconds = now - start;
+    run->cycles  = (cycles == 0) ? 0 : wolfsslCycles() - cycles;
+
+    return ret;
+}
+
+/*
+ * calls wolfsslBenchMessageOp until timer seconds have gone by, reading the
+ * clock around every call and counting its nanoseconds in w->hist
+ */
+static int wolfsslBenchLatencyLoop(double timer, WolfsslBenchWorker* w)
+{
+    double  start;              /* start time */
+    double  before;             /* clock before this call */
+    double  after;              /* and after it */
+    int     ret = 0;            /* return variable */
+
+    w->run.blocks = 0;
+    start = after = wolfsslGetTime();
+
+    while (ret == 0 && after - start < timer) {
+        before = wolfsslGetTime();
+        ret    = wolfsslBenchMessageOp(w, w->out, w->in, (word32) w->sz);
+        after  = wolfsslGetTime();
+        wolfsslHistogramRecord(w->hist,
+                                (uint64_t) ((after - before) * 1e9 + 0.5));
+        w->run.blocks++;
+    }
+
+    w->run.seconds = after - start;
+    w->run.cycles  = 0;
+
+    return ret;
+}
+
+/*
+ * sets up a context and buffers of its own for one worker. The key and
+ * data are random.
+ */
+static int wolfsslBenchStart(WolfsslBenchWorker* w)
+{
+    const WolfsslBenchTest* test = w->test;
+    RNG     rng;                /* random number generator */
+    int     ret;                /* return variable */
+
+    /* room for a whole last block */
+    w->max = w->sz + test->bench->block;
+    w->in  = wolfsslBufAlloc(w->max);
+    w->out = wolfsslBufAlloc(w->max);
+    if (w->in == NULL || w->out == NULL)
+        return MEMORY_E;
+
+    ret = wc_InitRng(&rng);
+    if (ret != 0)
+        return ret;
+    wc_RNG_GenerateBlock(&rng, w->in, w->max);
+    wc_RNG_GenerateBlock(&rng, w->key, sizeof(w->key));
+    wc_RNG_GenerateBlock(&rng, w->iv, sizeof(w->iv));
+    wc_FreeRng(&rng);
+
+    return test->bench->setup != NULL ? test->bench->setup(w) : 0;
+}
+
+/*
+ * finishes and clears what wolfsslBenchStart set up
+ */
+static void wolfsslBenchEnd(WolfsslBenchWorker* w)
+{
+    if (w->test->bench->teardown != NULL)
+        w->test->bench->teardown(w);
+    XMEMSET(w->key, 0, sizeof(w->key));
+    XMEMSET(w->iv, 0, sizeof(w->iv));
+
+    wolfsslBufFree(w->in);
+    wolfsslBufFree(w->out);
+    w->in = w->out = NULL;
+}
+
+#ifdef HAVE_PTHREAD
+/*
+ * holds every worker until all of them are set up, so they run together
+ */
+static void wolfsslBenchGateWait(WolfsslBenchGate* gate)
+{
+    pthread_mutex_lock(&gate->lock);
+    if (++gate->waiting == gate->count)
+        pthread_cond_broadcast(&gate->cond);
+    while (gate->waiting < gate->count)
+        pthread_cond_wait(&gate->cond, &gate->lock);
+    pthread_mutex_unlock(&gate->lock);
+}
+
+/*
+ * completion of a worker, one dropped by SIGINT before it ran no longer
+ * holds up the gate
+ */
+static void wolfsslBenchDropped(void* arg, int ret)
+{
+    WolfsslBenchWorker* w = (WolfsslBenchWorker*) arg;
+
+    if (ret != POOL_CANCELLED)
+        return;
+    w->ret = ret;
+    pthread_mutex_lock(&w->gate->lock);
+    w->gate->count--;
+    pthread_cond_broadcast(&w->gate->cond);
+    pthread_mutex_unlock(&w->gate->lock);
+}
+
+/*
+ * keeps the calling thread on the cpu'th processor it may run on
+ */
+static void wolfsslBenchPin(int cpu)
+{
+#ifdef __linux__
+    cpu_set_t allowed;          /* processors this process may use */
+    cpu_set_t one;              /* the one picked */
+    int       n = 0;            /* allowed processors */
+    int       c;                /* loop variable */
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return;
+    n = CPU_COUNT(&allowed);
+    if (n == 0)
+        return;
+    cpu %= n;
+    for (c = 0; c < CPU_SETSIZE; c++) {
+        if (CPU_ISSET(c, &allowed) && cpu-- == 0) {
+            CPU_ZERO(&one);
+            CPU_SET(c, &one);
+            sched_setaffinity(0, sizeof(one), &one);
+            return;
+        }
+    }
+#else
+    (void) cpu;
 #endif
+}
+#endif /* HAVE_PTHREAD */
 
-#ifndef NO_DES3
-    Des3 des3;                      /* 3des declaration */
+/*
+ * one worker: sets up and warms up, waits for the others, then runs its
+ * timed loop. A pool task, or called directly without threads.
+ */
+static int wolfsslBenchWork(void* arg, int thread)
+{
+    WolfsslBenchWorker* w = (WolfsslBenchWorker*) arg;
+
+    (void) thread;
+
+#ifdef HAVE_PTHREAD
+    if (w->gate != NULL)
+        wolfsslBenchPin(w->cpu);
+#endif
+    w->ret = wolfsslBenchStart(w);
+    /* caches, branch predictors and clock speed settle before timing */
+    if (w->ret == 0 && w->warmup > 0)
+        w->ret = wolfsslBenchLoop(w->warmup,
+                    w->hist != NULL ? wolfsslBenchMessageOp : w->test->op,
+                    w, w->out, w->in, w->sz, &w->run);
+#ifdef HAVE_PTHREAD
+    /* a worker that failed still has to let the others go */
+    if (w->gate != NULL)
+        wolfsslBenchGateWait(w->gate);
 #endif
+    if (w->ret == 0 && w->hist != NULL)
+        w->ret = wolfsslBenchLatencyLoop(w->timer, w);
+    else if (w->ret == 0)
+        w->ret = wolfsslBenchLoop(w->timer, w->test->op, w, w->out, w->in,
+                                                            w->sz, &w->run);
+    wolfsslBenchEnd(w);
 
-    RNG rng;                        /* random number generator */
+    return w->ret;
+}
 
-    int             ret  = 0;       /* return variable */
-    double          stop = 0.0;     /* stop breaks loop */
-    double          start;          /* start time */
-    double          currTime;       /* current time*/
-    
+/*
+ * runs test at sz bytes per call on threads pinned workers at once, or on
+ * this thread, unpinned, when threads is 0. With hists, one per worker,
+ * every call is timed into them instead.
+ */
+static int wolfsslBenchRunWorkers(const WolfsslBenchTest* test, int timer,
+                            int sz, int threads, WolfsslBenchWorker* workers,
+                            WolfsslHistogram* hists)
+{
+    int     i;                  /* loop variable */
+    int     ret     = 0;        /* return variable */
+#ifdef HAVE_PTHREAD
+    WolfsslBenchGate gate;      /* starts the workers together */
+    WolfsslPool      pool;      /* a thread per worker */
+#endif
 
-    ALIGN16 byte*   plain;          /* plain text */
-    ALIGN16 byte*   cipher;         /* cipher */
-    ALIGN16 byte*   key;            /* key for testing */
-    ALIGN16 byte*   iv;             /* iv for initial encoding */
-    
-    byte*           digest;         /* message digest */
+    XMEMSET(workers, 0, sizeof(WolfsslBenchWorker) *
+                                                (threads > 0 ? threads : 1));
+    for (i = 0; i < (threads > 0 ? threads : 1); i++) {
+        workers[i].test   = test;
+        workers[i].warmup = BENCH_WARMUP;
+        workers[i].timer  = timer;
+        workers[i].sz    = sz;
+        workers[i].cpu   = i;
+        workers[i].hist  = (hists != NULL) ? &hists[i] : NULL;
+    }
 
-    wc_InitRng(&rng);
+    if (threads == 0)
+        return wolfsslBenchWork(&workers[0], 0);
 
-    signal(SIGALRM, wolfsslStop);
-    i = 0;
-#ifndef NO_AES
-    /* aes test */
-    if (option[i] == 1) {
-        plain = malloc(AES_BLOCK_SIZE);
-        cipher = malloc(AES_BLOCK_SIZE);
-        key = malloc(AES_BLOCK_SIZE);
-        iv = malloc(AES_BLOCK_SIZE);
-
-        wc_RNG_GenerateBlock(&rng, plain, AES_BLOCK_SIZE);
-        wc_RNG_GenerateBlock(&rng, cipher, AES_BLOCK_SIZE);
-        wc_RNG_GenerateBlock(&rng, key, AES_BLOCK_SIZE);
-        wc_RNG_GenerateBlock(&rng, iv, AES_BLOCK_SIZE);
-        start = wolfsslGetTime();
-        alarm(timer);
-
-        wc_AesSetKey(&aes, key, AES_BLOCK_SIZE, iv, AES_ENCRYPTION);
-
-        while (loop) {
-            wc_AesCbcEncrypt(&aes, cipher, plain, AES_BLOCK_SIZE);
-            blocks++;
-            currTime = wolfsslGetTime();
-            stop = currTime - start;
-            /* if stop >= timer, loop = 0 */
-            loop = (stop >= timer) ? 0 : 1;
+#ifdef HAVE_PTHREAD
+    /* the workers wait for each other, each needs a thread of its own */
+    wolfsslPoolInit(&pool, threads, threads);
+    if (pool.threads < threads) {
+        wolfsslPoolFree(&pool);
+        return FATAL_ERROR;
+    }
+
+    pthread_mutex_init(&gate.lock, NULL);
+    pthread_cond_init(&gate.cond, NULL);
+    gate.waiting = 0;
+    gate.count   = threads;
+
+    for (i = 0; i < threads; i++) {
+        workers[i].gate = &gate;
+        wolfsslPoolSubmit(&pool, &workers[i].task, wolfsslBenchWork,
+                                            wolfsslBenchDropped, &workers[i]);
+    }
+    for (i = 0; i < threads; i++) {
+        if (wolfsslPoolWait(&pool, &workers[i].task) != 0 && ret == 0)
+            ret = workers[i].task.ret;
+    }
+    wolfsslPoolFree(&pool);
+    pthread_mutex_destroy(&gate.lock);
+    pthread_cond_destroy(&gate.cond);
+#else
+    ret = FATAL_ERROR;
+#endif
+
+    return ret;
+}
+
+/* MB/s of one worker, or keys set up or derived per second when sz is 0 */
+#define BENCH_RATE(w) ((w)->sz > 0 ? \
+        ((double) (w)->run.blocks * (w)->sz / MEGABYTE) / (w)->run.seconds : \
+        (double) (w)->run.blocks / (w)->run.seconds)
+
+/*
+ * qsort order for doubles
+ */
+static int wolfsslBenchOrder(const void* a, const void* b)
+{
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * sorts n values and returns the one at fraction q of the way through them
+ */
+static double wolfsslBenchRank(double* v, int n, double q)
+{
+    int idx;                    /* nearest rank */
+
+    qsort(v, n, sizeof(double), wolfsslBenchOrder);
+    idx = (int) (q * n + 0.999999) - 1;
+
+    return v[idx < 0 ? 0 : idx];
+}
+
+/*
+ * runs test at sz bytes on threads workers opts->reps times, each run after
+ * a warmup, and summarises the aggregate MB/s of the runs
+ */
+static int wolfsslBenchReps(const WolfsslBenchTest* test,
+                    const WolfsslBenchOpts* opts, int sz, int threads,
+                    WolfsslBenchWorker* workers, WolfsslBenchSummary* sum)
+{
+    double  mbs[MAX_BENCH_REPS];    /* aggregate rate of each run */
+    double  cpb[MAX_BENCH_REPS];    /* cycles/byte or /setup of each run */
+    double  one;                /* rate of one thread */
+    int     r, i;               /* loop variables */
+    int     ret = 0;            /* return variable */
+
+    XMEMSET(sum, 0, sizeof(WolfsslBenchSummary));
+
+    for (r = 0; r < opts->reps; r++) {
+        ret = wolfsslBenchRunWorkers(test, opts->time, sz, threads, workers,
+                                                                    NULL);
+        if (ret != 0)
+            return ret;
+
+        mbs[r] = 0;
+        for (i = 0; i < (threads > 0 ? threads : 1); i++) {
+            one     = BENCH_RATE(&workers[i]);
+            mbs[r] += one;
+            if ((r == 0 && i == 0) || one < sum->slowest)
+                sum->slowest = one;
         }
+        cpb[r] = workers[0].run.cycles == 0 ? 0 :
+                (double) workers[0].run.cycles /
+                ((double) workers[0].run.blocks * (sz > 0 ? sz : 1));
+        sum->mean += mbs[r];
+        sum->last  = workers[0].run;
+    }
+
+    sum->mean /= opts->reps;
+    for (r = 0; r < opts->reps; r++)
+        sum->stddev += (mbs[r] - sum->mean) * (mbs[r] - sum->mean);
+    if (opts->reps > 1)
+        sum->stddev = sqrt(sum->stddev / (opts->reps - 1));
+    sum->cv     = sum->mean > 0 ? 100.0 * sum->stddev / sum->mean : 0;
+    sum->median = wolfsslBenchRank(mbs, opts->reps, 0.5);
+    sum->p95    = wolfsslBenchRank(mbs, opts->reps, 0.95);
+    sum->min    = mbs[0];
+    sum->cpb    = wolfsslBenchRank(cpb, opts->reps, 0.5);
+    if (sum->cv > BENCH_NOISY)
+        noisy++;
+
+    return 0;
+}
+
+/*
+ * names a result of test at sz bytes on threads
+ */
+static void wolfsslBenchResultInit(const WolfsslBenchTest* test, int sz,
+                                        int threads, WolfsslBenchResult* r)
+{
+    XMEMSET(r, 0, sizeof(WolfsslBenchResult));
+    snprintf(r->name, sizeof(r->name), "%s", test->algName);
+    snprintf(r->op, sizeof(r->op), "%s", test->action == 'e' ? "encrypt" :
+                                          test->action == 'd' ? "decrypt" :
+                                          test->action == 'k' ? "keysetup" :
+                                          test->action == 'p' ? "derive" :
+                                                                "hash");
+    r->keySz   = test->keySz;
+    r->size    = sz;
+    r->threads = threads > 0 ? threads : 1;
+}
+
+/*
+ * keeps the summary of test at sz bytes on threads for -format and -baseline
+ */
+static int wolfsslBenchKeep(const WolfsslBenchTest* test, int sz,
+                                    int threads, const WolfsslBenchSummary* sum)
+{
+    WolfsslBenchResult r;       /* the summary as a result */
+
+    wolfsslBenchResultInit(test, sz, threads, &r);
+    r.mbs     = sz > 0 ? sum->median : 0;
+    r.ops     = sz > 0 ? sum->median * MEGABYTE / sz : sum->median;
+    r.min     = sum->min;
+    r.mean    = sum->mean;
+    r.stddev  = sum->stddev;
+    r.p95     = sum->p95;
+    r.cpb     = sum->cpb;
+
+    return wolfsslBenchAdd(&results, &r);
+}
+
+/*
+ * runs test at sz bytes on 1 thread and then on more, up to opts->threads,
+ * printing aggregate and per thread MB/s, or keys/s, and how well it
+ * scales. With -reps every figure is the median run.
+ */
+static int wolfsslBenchScaling(const WolfsslBenchTest* test,
+                                        const WolfsslBenchOpts* opts, int sz)
+{
+    WolfsslBenchWorker* workers;    /* one per thread */
+    WolfsslBenchSummary sum;    /* the runs at one thread count */
+    const char* unit = sz > 0 ? "MB/s" : "keys/s";
+    char    aggregate[24];      /* column headings with the unit */
+    char    perThread[24];
+    char    slowest[24];
+    double  single = 0;         /* aggregate rate on one thread */
+    int     threads = 1;        /* threads in this run */
+    int     ret = 0;            /* return variable */
+
+    workers = (WolfsslBenchWorker*) malloc(sizeof(WolfsslBenchWorker) *
+                                                                opts->threads);
+    if (workers == NULL)
+        return MEMORY_E;
+
+    if (opts->format == WOLFSSL_BENCH_TEXT) {
+        snprintf(aggregate, sizeof(aggregate), "aggregate %s", unit);
+        snprintf(perThread, sizeof(perThread), "per thread %s", unit);
+        snprintf(slowest, sizeof(slowest), "slowest %s", unit);
+        if (sz > 0)
+            printf("%s, %d bytes per call\n", test->name, sz);
+        else
+            printf("%s\n", test->name);
+        printf("%9s %18s %18s %15s %11s\n", "threads", aggregate, perThread,
+                                                    slowest, "efficiency");
+    }
+
+    while (ret == 0) {
+        ret = wolfsslBenchReps(test, opts, sz, threads, workers, &sum);
+        if (ret == 0)
+            ret = wolfsslBenchKeep(test, sz, threads, &sum);
+        if (ret != 0)
+            break;
+
+        if (threads == 1)
+            single = sum.median;
+        if (opts->format == WOLFSSL_BENCH_TEXT)
+            printf("%9d %18.1f %18.1f %15.1f %10.1f%%%s\n", threads,
+                    sum.median, sum.median / threads, sum.slowest,
+                    single > 0 ? 100.0 * sum.median / (single * threads) : 0.0,
+                    sum.cv > BENCH_NOISY ? " *" : "");
+        fflush(stdout);
+
+        if (threads == opts->threads)
+            break;
+        /* a sweep doubles the threads each time, otherwise 1 then all */
+        threads = (opts->threadSweep && threads * 2 < opts->threads) ?
+                                                threads * 2 : opts->threads;
+    }
+    if (opts->format == WOLFSSL_BENCH_TEXT)
         printf("\n");
-        printf("AES-CBC ");
-        wolfsslStats(start, AES_BLOCK_SIZE, blocks);
-        XMEMSET(plain, 0, AES_BLOCK_SIZE);
-        XMEMSET(cipher, 0, AES_BLOCK_SIZE);
-        XMEMSET(key, 0, AES_BLOCK_SIZE);
-        XMEMSET(iv, 0, AES_BLOCK_SIZE);
-        free(plain);
-        free(cipher);
-        free(key);
-        free(iv);
-        blocks = 0;
-        loop = 1;
+    free(workers);
+
+    return ret;
+}
+
+/*
+ * prints the spread of -reps runs of one benchmark
+ */
+static void wolfsslBenchPrintSummary(const WolfsslBenchTest* test, int sz,
+                                    int reps, const WolfsslBenchSummary* sum)
+{
+    if (sz > 0)
+        printf("%s %d runs, %d bytes per call\n", test->name, reps, sz);
+    else
+        printf("%s %d runs\n", test->name, reps);
+    printf("%s min %.1f, median %.1f, mean %.1f, stddev %.1f, p95 %.1f\n",
+                sz > 0 ? "MB/s" : "Keys/s", sum->min, sum->median,
+                sum->mean, sum->stddev, sum->p95);
+    if (sum->cpb > 0)
+        printf("Cycles/%s median %.2f\n", sz > 0 ? "byte" : "key",
+                                                                    sum->cpb);
+    if (sum->cv > BENCH_NOISY)
+        printf("Warning: runs vary by %.1f%% (coefficient of variation), "
+               "results are noisy\n", sum->cv);
+    printf("\n");
+}
+
+/*
+ * times every call of test at sz bytes, on -threads workers at once if
+ * given, opts->reps times over, and prints one row of the latency table
+ */
+static int wolfsslBenchLatency(const WolfsslBenchTest* test,
+                                        const WolfsslBenchOpts* opts, int sz)
+{
+    WolfsslBenchWorker* workers;    /* one per thread */
+    WolfsslHistogram*   hists;  /* and a histogram each */
+    WolfsslBenchResult  r;      /* the histogram as a result */
+    int     count = opts->threads > 0 ? opts->threads : 1;
+    int     i;                  /* loop variable */
+    int     ret = 0;            /* return variable */
+
+    workers = (WolfsslBenchWorker*) malloc(sizeof(WolfsslBenchWorker) * count);
+    hists   = (WolfsslHistogram*) malloc(sizeof(WolfsslHistogram) * count);
+    if (workers == NULL || hists == NULL) {
+        free(workers);
+        free(hists);
+        return MEMORY_E;
     }
-    i++;
-#endif
-#ifdef WOLFSSL_AES_COUNTER
-    /* aes-ctr test */
-    if (option[i] == 1) {
-        plain = malloc(AES_BLOCK_SIZE);
-        cipher = malloc(AES_BLOCK_SIZE);
-        key = malloc(AES_BLOCK_SIZE);
-        iv = malloc(AES_BLOCK_SIZE);
-
-        wc_RNG_GenerateBlock(&rng, plain, AES_BLOCK_SIZE);
-        wc_RNG_GenerateBlock(&rng, cipher, AES_BLOCK_SIZE);
-        wc_RNG_GenerateBlock(&rng, key, AES_BLOCK_SIZE);
-        wc_RNG_GenerateBlock(&rng, iv, AES_BLOCK_SIZE);
-        start = wolfsslGetTime();
-        alarm(timer);
-
-        wc_AesSetKeyDirect(&aes, key, AES_BLOCK_SIZE, iv, AES_ENCRYPTION);
-        while (loop) {
-            wc_AesCtrEncrypt(&aes, cipher, plain, AES_BLOCK_SIZE);
-            blocks++;
-            currTime = wolfsslGetTime();
-            stop = currTime - start;
-            /* if stop >= timer, loop = 0 */
-            loop = (stop >= timer) ? 0 : 1;
+    for (i = 0; i < count; i++)
+        wolfsslHistogramInit(&hists[i]);
+
+    /* every run adds to the same histograms */
+    for (i = 0; ret == 0 && i < opts->reps; i++)
+        ret = wolfsslBenchRunWorkers(test, opts->time, sz, opts->threads,
+                                                            workers, hists);
+    for (i = 1; ret == 0 && i < count; i++)
+        wolfsslHistogramMerge(&hists[0], &hists[i]);
+
+    if (ret == 0 && hists[0].total > 0) {
+        wolfsslBenchResultInit(test, sz, opts->threads, &r);
+        /* calls/s from the mean latency, on every thread at once */
+        r.ops = count * 1e9 * hists[0].total / (double) hists[0].sum;
+        r.mbs = r.ops * sz / MEGABYTE;
+        for (i = 0; i < BENCH_LATENCIES; i++)
+            r.latency[i] = (double) wolfsslHistogramPercentile(&hists[0],
+                                                        benchLatencies[i]);
+        ret = wolfsslBenchAdd(&results, &r);
+
+        if (ret == 0 && opts->format == WOLFSSL_BENCH_TEXT) {
+            /* key setups and derivations have no message size */
+            if (sz > 0)
+                printf("%-22s %8d", test->name, sz);
+            else
+                printf("%-22s %8s", test->name, "-");
+            printf(" %10.0f", (double) hists[0].total);
+            for (i = 0; i < BENCH_LATENCIES; i++)
+                printf(" %9.0f", r.latency[i]);
+            printf("\n");
+            fflush(stdout);
         }
-        printf("AES-CTR ");
-        wolfsslStats(start, AES_BLOCK_SIZE, blocks);
-        XMEMSET(plain, 0, AES_BLOCK_SIZE);
-        XMEMSET(cipher, 0, AES_BLOCK_SIZE);
-        XMEMSET(key, 0, AES_BLOCK_SIZE);
-        XMEMSET(iv, 0, AES_BLOCK_SIZE);
-        free(plain);
-        free(cipher);
-        free(key);
-        free(iv);
-        blocks = 0;
-        loop = 1;
     }
-    i++;
-#endif
-#ifndef NO_DES3
-    /* 3des test */
-    if (option[i] == 1) {   
-        plain = malloc(DES3_BLOCK_SIZE);
-        cipher = malloc(DES3_BLOCK_SIZE);
-        key = malloc(DES3_BLOCK_SIZE);
-        iv = malloc(DES3_BLOCK_SIZE);
-
-        wc_RNG_GenerateBlock(&rng, plain, DES3_BLOCK_SIZE);
-        wc_RNG_GenerateBlock(&rng, cipher, DES3_BLOCK_SIZE);
-        wc_RNG_GenerateBlock(&rng, key, DES3_BLOCK_SIZE);
-        wc_RNG_GenerateBlock(&rng, iv, DES3_BLOCK_SIZE);
-
-        start = wolfsslGetTime();
-        alarm(timer);
-
-        wc_Des3_SetKey(&des3, key, iv, DES_ENCRYPTION);
-        while (loop) {
-            wc_Des3_CbcEncrypt(&des3, cipher, plain, DES3_BLOCK_SIZE);
-            blocks++;
-            currTime = wolfsslGetTime();
-            stop = currTime - start;
-            /* if stop >= timer, loop = 0 */
-            loop = (stop >= timer) ? 0 : 1;
+
+    free(workers);
+    free(hists);
+
+    return ret;
+}
+
+/*
+ * runs test at every -sizes size, or once at its own size without a sweep,
+ * printing wolfsslStats for the single run, one row of the MB/s table for
+ * a sweep, a scaling table per size with -threads or a row of the latency
+ * table per size with -latency. Key setups and derivations don't depend on
+ * a size and run once.
+ */
+static int wolfsslBenchSizes(const WolfsslBenchTest* test,
+                                                const WolfsslBenchOpts* opts)
+{
+    WolfsslBenchWorker  worker; /* the one worker without -threads */
+    WolfsslBenchSummary sum;    /* the -reps runs at one size */
+    int     count = (opts->sizeCount > 0 && test->size > 0) ?
+                                                        opts->sizeCount : 1;
+    int     sz;                 /* bytes per call */
+    int     i;                  /* loop variable */
+    int     ret = 0;            /* return variable */
+
+    if (opts->format == WOLFSSL_BENCH_TEXT && opts->threads == 0 &&
+                                    opts->sizeCount > 0 && !opts->latency) {
+        printf("%-22s", test->name);
+        fflush(stdout);
+    }
+
+    for (i = 0; ret == 0 && i < count; i++) {
+        sz = test->size;
+        if (opts->sizeCount > 0 && test->size > 0) {
+            /* ciphers only take whole blocks */
+            sz = opts->sizes[i] - opts->sizes[i] % test->bench->block;
+            if (sz == 0)
+                sz = test->bench->block;
+        }
+
+        if (opts->latency) {
+            ret = wolfsslBenchLatency(test, opts, sz);
+            continue;
+        }
+        if (opts->threads > 0) {
+            ret = wolfsslBenchScaling(test, opts, sz);
+            continue;
+        }
+
+        ret = wolfsslBenchReps(test, opts, sz, 0, &worker, &sum);
+        if (ret == 0)
+            ret = wolfsslBenchKeep(test, sz, 0, &sum);
+        if (ret != 0 || opts->format != WOLFSSL_BENCH_TEXT)
+            continue;
+        if (opts->sizeCount > 0 && sz == 0) {
+            printf(" %9.0f%c keys/s", sum.median,
+                                        sum.cv > BENCH_NOISY ? '*' : ' ');
+            fflush(stdout);
+        }
+        else if (opts->sizeCount > 0) {
+            printf(" %9.1f%c", sum.median, sum.cv > BENCH_NOISY ? '*' : ' ');
+            fflush(stdout);
+        }
+        else if (opts->reps > 1)
+            wolfsslBenchPrintSummary(test, sz, opts->reps, &sum);
+        else {
+            printf("%s ", test->name);
+            wolfsslStats(sum.last.seconds, sum.last.cycles, sz,
+                                                            sum.last.blocks);
         }
-        printf("3DES ");
-        wolfsslStats(start, DES3_BLOCK_SIZE, blocks);
-        XMEMSET(plain, 0, DES3_BLOCK_SIZE);
-        XMEMSET(cipher, 0, DES3_BLOCK_SIZE);
-        XMEMSET(key, 0, DES3_BLOCK_SIZE);
-        XMEMSET(iv, 0, DES3_BLOCK_SIZE);
-        free(plain);
-        free(cipher);
-        free(key);
-        free(iv);
-        blocks = 0;
-        loop = 1;
     }
-    i++;
-#endif
-#ifdef HAVE_CAMELLIA
-    /* camellia test */
-    if (option[i] == 1) {
-        Camellia camellia;
-
-        plain = malloc(CAMELLIA_BLOCK_SIZE);
-        cipher = malloc(CAMELLIA_BLOCK_SIZE);
-        key = malloc(CAMELLIA_BLOCK_SIZE);
-        iv = malloc(CAMELLIA_BLOCK_SIZE);
-
-        wc_RNG_GenerateBlock(&rng, plain, CAMELLIA_BLOCK_SIZE);
-        wc_RNG_GenerateBlock(&rng, cipher, CAMELLIA_BLOCK_SIZE);
-        wc_RNG_GenerateBlock(&rng, key, CAMELLIA_BLOCK_SIZE);
-        wc_RNG_GenerateBlock(&rng, iv, CAMELLIA_BLOCK_SIZE);
-
-        start = wolfsslGetTime();
-        alarm(timer);
-
-        wc_CamelliaSetKey(&camellia, key, CAMELLIA_BLOCK_SIZE, iv);
-        while (loop) {
-            wc_CamelliaCbcEncrypt(&camellia, cipher, plain, CAMELLIA_BLOCK_SIZE);
-            blocks++;
-            currTime = wolfsslGetTime();
-            stop = currTime - start;
-            /* if stop >= timer, loop = 0 */
-            loop = (stop >= timer) ? 0 : 1;
+
+    if (opts->format == WOLFSSL_BENCH_TEXT && opts->threads == 0 &&
+                                    opts->sizeCount > 0 && !opts->latency)
+        printf("\n");
+
+    return ret;
+}
+
+/*
+ * benchmarks encryption, decryption and key setup with a random key and IV
+ * at each of bench's key sizes, skipping the operations -ops leaves out
+ */
+static int wolfsslBenchCipher(const WolfsslBenchCase* bench,
+                                                const WolfsslBenchOpts* opts)
+{
+    static const int  ops[]     = {WOLFSSL_BENCH_ENCRYPT,
+                                   WOLFSSL_BENCH_DECRYPT,
+                                   WOLFSSL_BENCH_KEYSETUP};
+    static const char actions[] = {'e', 'd', 'k'};
+    static const char* verbs[]  = {"encrypt", "decrypt", "keysetup"};
+    WolfsslBenchTest test;      /* one operation at one key size */
+    int     k, a;               /* loop variables */
+    int     ret = 0;            /* return variable */
+
+    for (k = 0; ret == 0 && k < bench->keyCount; k++) {
+        for (a = 0; ret == 0 && a < (int) sizeof(actions); a++) {
+            if ((opts->ops & ops[a]) == 0)
+                continue;
+            /* ctr decrypts by encrypting */
+            if (actions[a] == 'd' && XSTRNCMP(bench->mode, "ctr", 3) == 0)
+                continue;
+
+            XMEMSET(&test, 0, sizeof(test));
+            snprintf(test.name, sizeof(test.name), "%s-%d %s", bench->title,
+                                                    bench->keys[k], verbs[a]);
+            test.bench   = bench;
+            test.algName = bench->title;
+            test.size    = actions[a] == 'k' ? 0 : bench->size;
+            test.keySz   = bench->keys[k];
+            test.action  = actions[a];
+            test.op      = actions[a] == 'k' ? wolfsslBenchKeyOp : bench->op;
+
+            ret = wolfsslBenchSizes(&test, opts);
         }
-        printf("Camellia ");
-        wolfsslStats(start, CAMELLIA_BLOCK_SIZE, blocks);
-        XMEMSET(plain, 0, CAMELLIA_BLOCK_SIZE);
-        XMEMSET(cipher, 0, CAMELLIA_BLOCK_SIZE);
-        XMEMSET(key, 0, CAMELLIA_BLOCK_SIZE);
-        XMEMSET(iv, 0, CAMELLIA_BLOCK_SIZE);
-        free(plain);
-        free(cipher);
-        free(key);
-        free(iv);
-        blocks = 0;
-        loop = 1;
     }
-    i++;
+
+    return ret;
+}
+
+#ifndef NO_PWDBASED
+/*
+ * benchmarks PBKDF2-SHA256 key derivations at each of bench's iteration
+ * counts, with the longest key a cipher reads
+ */
+static int wolfsslBenchKdf(const WolfsslBenchCase* bench,
+                                                const WolfsslBenchOpts* opts)
+{
+    WolfsslBenchTest test;      /* one iteration count */
+    int     k;                  /* loop variable */
+    int     ret = 0;            /* return variable */
+
+    for (k = 0; ret == 0 && k < bench->keyCount; k++) {
+        XMEMSET(&test, 0, sizeof(test));
+        snprintf(test.name, sizeof(test.name), "%s-%d", bench->title,
+                                                            bench->keys[k]);
+        /* each count is its own algorithm in the results */
+        test.bench      = bench;
+        test.algName    = test.name;
+        test.keySz      = 8 * MAX_KEY_SIZE;
+        test.iterations = bench->keys[k];
+        test.action     = 'p';
+        test.op         = bench->op;
+
+        ret = wolfsslBenchSizes(&test, opts);
+    }
+
+    return ret;
+}
+#endif
+
+/*
+ * benchmarks a hash over random data
+ */
+static int wolfsslBenchDigest(const WolfsslBenchCase* bench,
+                                                const WolfsslBenchOpts* opts)
+{
+    WolfsslBenchTest test;      /* the one test of a hash */
+
+    XMEMSET(&test, 0, sizeof(test));
+    snprintf(test.name, sizeof(test.name), "%s", bench->title);
+    test.bench   = bench;
+    test.algName = bench->title;
+    test.size    = bench->size;
+    test.action  = 'h';
+    test.op      = bench->op;
+
+    return wolfsslBenchSizes(&test, opts);
+}
+
+/* the functions of each kind of benchmark, for the table */
+#define BENCH_CIPHER wolfsslBenchCipherSetup, wolfsslBenchCipherOp, \
+                     wolfsslBenchCipherTeardown, wolfsslBenchCipher
+#define BENCH_DIGEST wolfsslBenchDigestSetup, wolfsslBenchDigestOp, \
+                     wolfsslBenchDigestTeardown, wolfsslBenchDigest
+#define BENCH_KDF    NULL, wolfsslBenchKdfOp, NULL, wolfsslBenchKdf
+
+/* every benchmark this build has, in the order they run and are listed by
+ * -help. -bench selects them by name. Adding one is adding a line here */
+static const WolfsslBenchCase benchCases[] = {
+    /* name, title, alg, mode, block, bytes per call, digest size,
+     * key sizes or counts, functions */
+#ifndef NO_AES
+    {"aes-cbc", "AES-CBC", "aes", "cbc", AES_BLOCK_SIZE, AES_BLOCK_SIZE, 0,
+                                        BENCH_KEYS(blockKeys), BENCH_CIPHER},
+#endif
+#ifdef WOLFSSL_AES_COUNTER
+    {"aes-ctr", "AES-CTR", "aes", "ctr", AES_BLOCK_SIZE, AES_BLOCK_SIZE, 0,
+                                        BENCH_KEYS(blockKeys), BENCH_CIPHER},
+#endif
+#ifndef NO_DES3
+    {"3des", "3DES", "3des", "cbc", DES_BLOCK_SIZE, DES3_BLOCK_SIZE, 0,
+                                        BENCH_KEYS(des3Keys), BENCH_CIPHER},
+#endif
+#ifdef HAVE_CAMELLIA
+    {"camellia", "Camellia", "camellia", "cbc", CAMELLIA_BLOCK_SIZE,
+                CAMELLIA_BLOCK_SIZE, 0, BENCH_KEYS(blockKeys), BENCH_CIPHER},
 #endif
 #ifndef NO_MD5
-    /* md5 test */
-    if (option[i] == 1) {
-        Md5 md5;
-
-        digest = malloc(MD5_DIGEST_SIZE);
-        plain = malloc(MEGABYTE);
-        wc_RNG_GenerateBlock(&rng, plain, MEGABYTE);
-
-        wc_InitMd5(&md5);
-        start = wolfsslGetTime();
-        alarm(timer);
-
-        while (loop) {
-            wc_Md5Update(&md5, plain, MEGABYTE);
-            blocks++;
-            currTime = wolfsslGetTime();
-            stop = currTime - start;
-            /* if stop >= timer, loop = 0 */
-            loop = (stop >= timer) ? 0 : 1;
-        }
-        wc_Md5Final(&md5, digest);
-        printf("MD5 ");
-        wolfsslStats(start, MEGABYTE, blocks);
-        XMEMSET(plain, 0, MEGABYTE);
-        XMEMSET(digest, 0, MD5_DIGEST_SIZE);
-        free(plain);
-        free(digest);
-        blocks = 0;
-        loop = 1;
-    }
-    i++;
+    {"md5", "MD5", "md5", NULL, 1, MEGABYTE, MD5_DIGEST_SIZE, NULL, 0,
+                                                                BENCH_DIGEST},
 #endif
 #ifndef NO_SHA
-    /* sha test */
-    if (option[i] == 1) {
-        Sha sha;
-
-        digest = malloc(SHA_DIGEST_SIZE);
-        plain = malloc(MEGABYTE);
-        wc_RNG_GenerateBlock(&rng, plain, MEGABYTE);
-
-        wc_InitSha(&sha);
-        start = wolfsslGetTime();
-        alarm(timer);
-
-        while (loop) {
-            wc_ShaUpdate(&sha, plain, MEGABYTE);
-            blocks++;
-            currTime = wolfsslGetTime();
-            stop = currTime - start;
-            /* if stop >= timer, loop = 0 */
-            loop = (stop >= timer) ? 0 : 1;
-        }
-        wc_ShaFinal(&sha, digest);
-        printf("Sha ");
-        wolfsslStats(start, MEGABYTE, blocks);
-        XMEMSET(plain, 0, MEGABYTE);
-        XMEMSET(digest, 0, SHA_DIGEST_SIZE);
-        free(plain);
-        free(digest);
-        blocks = 0;
-        loop = 1;
-    }
-    i++;
+    {"sha", "Sha", "sha", NULL, 1, MEGABYTE, SHA_DIGEST_SIZE, NULL, 0,
+                                                                BENCH_DIGEST},
 #endif
 #ifndef NO_SHA256
-    /* sha256 test */
-    if (option[i] == 1) {
-        Sha256 sha256;
-
-        digest = malloc(SHA256_DIGEST_SIZE);
-        plain = malloc(MEGABYTE);
-        wc_RNG_GenerateBlock(&rng, plain, MEGABYTE);
-
-        wc_InitSha256(&sha256);
-        start = wolfsslGetTime();
-        alarm(timer);
-
-        while (loop) {
-            wc_Sha256Update(&sha256, plain, MEGABYTE);
-            blocks++;
-            currTime = wolfsslGetTime();
-            stop = currTime - start;
-            /* if stop >= timer, loop = 0 */
-            loop = (stop >= timer) ? 0 : 1;
-        }
-        wc_Sha256Final(&sha256, digest);
-        printf("Sha256 ");
-        wolfsslStats(start, MEGABYTE, blocks);
-        XMEMSET(plain, 0, MEGABYTE);
-        XMEMSET(digest, 0, SHA256_DIGEST_SIZE);
-        free(plain);
-        free(digest);
-        /* resets used for debug, uncomment if needed */
-        /* blocks = 0; */
-        /* loop = 1; */
-    }
-    i++;
+    {"sha256", "Sha256", "sha256", NULL, 1, MEGABYTE, SHA256_DIGEST_SIZE,
+                                                    NULL, 0, BENCH_DIGEST},
 #endif
 #ifdef WOLFSSL_SHA384
-    /* sha384 test */
-    if (option[i] == 1) {
-        Sha384 sha384;
-
-        digest = malloc(SHA384_DIGEST_SIZE);
-        plain = malloc(MEGABYTE);
-        wc_RNG_GenerateBlock(&rng, plain, MEGABYTE);
-
-        wc_InitSha384(&sha384);
-        start = wolfsslGetTime();
-        alarm(timer);
-
-        while (loop) {
-            wc_Sha384Update(&sha384, plain, MEGABYTE);
-            blocks++;
-            currTime = wolfsslGetTime();
-            stop = currTime - start;
-            /* if stop >= timer, loop = 0 */
-            loop = (stop >= timer) ? 0 : 1;
-        }
-        wc_Sha384Final(&sha384, digest);
-        printf("Sha384 ");
-        wolfsslStats(start, MEGABYTE, blocks);
-        XMEMSET(plain, 0, MEGABYTE);
-        XMEMSET(digest, 0, SHA384_DIGEST_SIZE);
-        free(plain);
-        free(digest);
-        blocks = 0;
-        loop = 1;
-    }
-    i++;
+    {"sha384", "Sha384", "sha384", NULL, 1, MEGABYTE, SHA384_DIGEST_SIZE,
+                                                    NULL, 0, BENCH_DIGEST},
 #endif
 #ifdef WOLFSSL_SHA512
-    /* sha512 test */
-    if (option[i] == 1) {
-        Sha512 sha512;
-
-        digest = malloc(SHA512_DIGEST_SIZE);
-        plain = malloc(MEGABYTE);
-        wc_RNG_GenerateBlock(&rng, plain, MEGABYTE);
-
-        wc_InitSha512(&sha512);
-        start = wolfsslGetTime();
-        alarm(timer);
-
-        while (loop) {
-            wc_Sha512Update(&sha512, plain, MEGABYTE);
-            blocks++;
-            currTime = wolfsslGetTime();
-            stop = currTime - start;
-            /* if stop >= timer, loop = 0 */
-            loop = (stop >= timer) ? 0 : 1;
-        }
-        wc_Sha512Final(&sha512, digest);
-        printf("Sha512 ");
-        wolfsslStats(start, MEGABYTE, blocks);
-        XMEMSET(plain, 0, MEGABYTE);
-        XMEMSET(digest, 0, SHA512_DIGEST_SIZE);
-        free(plain);
-        free(digest);
-        blocks = 0;
-        loop = 1;
-    }
-    i++;
+    {"sha512", "Sha512", "sha512", NULL, 1, MEGABYTE, SHA512_DIGEST_SIZE,
+                                                    NULL, 0, BENCH_DIGEST},
 #endif
 #ifdef HAVE_BLAKE2
-    /* blake2b test */
-    if (option[i] == 1) {
-        Blake2b  b2b;
-
-        digest = malloc(BLAKE_DIGEST_SIZE);
-        plain = malloc(MEGABYTE);
-        wc_RNG_GenerateBlock(&rng, plain, MEGABYTE);
-
-        wc_InitBlake2b(&b2b, BLAKE_DIGEST_SIZE);
-        start = wolfsslGetTime();
-        alarm(timer);
-
-        while (loop) {
-            wc_Blake2bUpdate(&b2b, plain, MEGABYTE);
-            blocks++;
-            currTime = wolfsslGetTime();
-            stop = currTime - start;
-            /* if stop >= timer, loop = 0 */
-            loop = (stop >= timer) ? 0 : 1;
-        }
-        wc_Blake2bFinal(&b2b, digest, BLAKE_DIGEST_SIZE);
-        printf("Blake2b ");
-        wolfsslStats(start, MEGABYTE, blocks);
-        XMEMSET(plain, 0, MEGABYTE);
-        XMEMSET(digest, 0, BLAKE_DIGEST_SIZE);
-        free(plain);
-        free(digest);
-    }
+    {"blake2b", "Blake2b", "blake2b", NULL, 1, MEGABYTE, BLAKE_DIGEST_SIZE,
+                                                    NULL, 0, BENCH_DIGEST},
 #endif
+#ifndef NO_PWDBASED
+    {"pbkdf2", "PBKDF2-SHA256", NULL, NULL, 1, 0, 0,
+                                        BENCH_KEYS(kdfIterations), BENCH_KDF},
+#endif
+    {NULL, NULL, NULL, NULL, 0, 0, 0, NULL, 0, NULL, NULL, NULL, NULL}
+};
+
+/*
+ * name of the idx'th benchmark, NULL past the last
+ */
+const char* wolfsslBenchName(int idx)
+{
+    if (idx < 0 || idx >= (int) (sizeof(benchCases) / sizeof(benchCases[0])))
+        return NULL;
+
+    return benchCases[idx].name;
+}
+
+/*
+ * benchmarking funciton
+ */
+int wolfsslBenchmark(const WolfsslBenchOpts* opts, int* option)
+{
+    int     i   = 0;            /* A looping variable */
+    int     ret = 0;            /* return variable */
+
+    batchTime = wolfsslBenchTimerCost() * TIMER_SHARE;
+    noisy     = 0;
+    XMEMSET(&results, 0, sizeof(results));
+
+    if (opts->format != WOLFSSL_BENCH_TEXT) {
+        /* the results are printed at the end */
+    }
+    else if (opts->latency) {
+        /* header of the latency table, one row per test and size */
+        printf("\nNanoseconds per call, context setup included%s, clock "
+               "reads add about %.0f ns\n", opts->threads > 0 ?
+               ", on every thread at once" : "", batchTime / TIMER_SHARE * 1e9);
+        printf("%-22s %8s %10s %9s %9s %9s %9s %9s\n", "", "bytes", "calls",
+               "p50", "p90", "p99", "p99.9", "max");
+    }
+    else if (opts->sizeCount > 0 && opts->threads == 0) {
+        /* header of the MB/s table, one column per size */
+        printf("\nMB/s by bytes per call%s\n%-22s",
+                    opts->reps > 1 ? ", median of the runs" : "", "");
+        for (i = 0; i < opts->sizeCount; i++)
+            printf(" %9d ", opts->sizes[i]);
+        printf("\n");
+    }
+    else
+        printf("\n");
+
+    for (i = 0; ret == 0 && benchCases[i].name != NULL; i++) {
+        if (option[i] == 1)
+            ret = benchCases[i].run(&benchCases[i], opts);
+    }
+
+    if (ret == 0 && noisy > 0 && opts->format == WOLFSSL_BENCH_TEXT &&
+                                (opts->sizeCount > 0 || opts->threads > 0))
+        printf("* runs varied by more than %.0f%% (coefficient of "
+               "variation), results are noisy\n", BENCH_NOISY);
+
+    if (ret == 0 && opts->format != WOLFSSL_BENCH_TEXT)
+        wolfsslBenchReport(&results, opts->format);
+    /* the comparison goes to stderr so it doesn't spoil json or csv */
+    if (ret == 0 && opts->baseline != NULL)
+        ret = wolfsslBenchCompare(&results, opts->baseline, opts->threshold,
+                        opts->format == WOLFSSL_BENCH_TEXT ? stdout : stderr);
+    wolfsslBenchResultsFree(&results);
+
     return ret;
 }
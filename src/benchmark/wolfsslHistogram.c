@@ -0,0 +1,112 @@
+/* wolfsslHistogram.c
+ *
+ * Copyright (C) 2006-2015 wolfSSL Inc.
+ *
+ * This file is part of wolfSSL. (formerly known as CyaSSL)
+ *
+ * wolfSSL is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfSSL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "include/wolfssl.h"
+
+#define HIST_HALF (1 << (HIST_SUB_BITS - 1))    /* buckets per power of two */
+
+/*
+ * bits a bucket of ns drops, 0 while every value has a bucket of its own
+ */
+static int wolfsslHistogramShift(uint64_t ns)
+{
+    int     msb = 0;            /* highest set bit */
+
+    while (msb < 63 && (ns >> (msb + 1)) != 0)
+        msb++;
+
+    return msb < HIST_SUB_BITS ? 0 : msb - (HIST_SUB_BITS - 1);
+}
+
+/*
+ * empties a histogram
+ */
+void wolfsslHistogramInit(WolfsslHistogram* hist)
+{
+    XMEMSET(hist, 0, sizeof(WolfsslHistogram));
+    hist->min = UINT64_MAX;
+}
+
+/*
+ * counts one value. Above 2^HIST_SUB_BITS the value keeps its top
+ * HIST_SUB_BITS bits, its bucket is those bits offset by how many it lost
+ */
+void wolfsslHistogramRecord(WolfsslHistogram* hist, uint64_t ns)
+{
+    int     shift = wolfsslHistogramShift(ns);
+
+    hist->counts[shift * HIST_HALF + (int) (ns >> shift)]++;
+    hist->total++;
+    hist->sum += ns;
+    if (ns < hist->min)
+        hist->min = ns;
+    if (ns > hist->max)
+        hist->max = ns;
+}
+
+/*
+ * adds every value of from to to
+ */
+void wolfsslHistogramMerge(WolfsslHistogram* to, const WolfsslHistogram* from)
+{
+    int     i;                  /* loop variable */
+
+    for (i = 0; i < HIST_BUCKETS; i++)
+        to->counts[i] += from->counts[i];
+    to->total += from->total;
+    to->sum   += from->sum;
+    if (from->min < to->min)
+        to->min = from->min;
+    if (from->max > to->max)
+        to->max = from->max;
+}
+
+/*
+ * finds the bucket holding the value ranked pct percent of the way up, and
+ * returns the highest value that bucket holds
+ */
+uint64_t wolfsslHistogramPercentile(const WolfsslHistogram* hist, double pct)
+{
+    uint64_t rank;              /* values at or below the one wanted */
+    uint64_t seen = 0;          /* values in the buckets so far */
+    uint64_t top;               /* highest value of a bucket */
+    int      shift;             /* bits the bucket drops */
+    int      i;                 /* loop variable */
+
+    if (hist->total == 0)
+        return 0;
+    if (pct >= 100)
+        return hist->max;
+
+    rank = (uint64_t) (pct / 100 * hist->total + 0.999999);
+    if (rank == 0)
+        rank = 1;
+
+    for (i = 0; i < HIST_BUCKETS; i++) {
+        seen += hist->counts[i];
+        if (seen >= rank)
+            break;
+    }
+    shift = (i < 2 * HIST_HALF) ? 0 : i / HIST_HALF - 1;
+    top   = (((uint64_t) (i - shift * HIST_HALF) + 1) << shift) - 1;
+
+    return top < hist->max ? top : hist->max;
+}
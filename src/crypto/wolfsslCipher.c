@@ -0,0 +1,212 @@
+/* wolfsslCipher.c
+ *
+ * Copyright (C) 2006-2015 wolfSSL Inc.
+ *
+ * This file is part of wolfSSL. (formerly known as CyaSSL)
+ *
+ * wolfSSL is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfSSL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "include/wolfssl.h"
+
+/* update functions, one per algorithm, mode and direction. Each one
+ * en/de crypts whole blocks and leaves the running IV in the context.
+ */
+#ifndef NO_AES
+static int wolfsslAesCbcEncrypt(WolfsslCipher* cipher, byte* out,
+                                                    const byte* in, word32 sz)
+{
+    return wc_AesCbcEncrypt(&cipher->ctx.aes, out, in, sz) == 0 ? 0 :
+                                                                ENCRYPT_ERROR;
+}
+
+static int wolfsslAesCbcDecrypt(WolfsslCipher* cipher, byte* out,
+                                                    const byte* in, word32 sz)
+{
+    return wc_AesCbcDecrypt(&cipher->ctx.aes, out, in, sz) == 0 ? 0 :
+                                                                DECRYPT_ERROR;
+}
+
+#ifdef WOLFSSL_AES_COUNTER
+static int wolfsslAesCtr(WolfsslCipher* cipher, byte* out, const byte* in,
+                                                                    word32 sz)
+{
+    wc_AesCtrEncrypt(&cipher->ctx.aes, out, in, sz);
+    return 0;
+}
+#endif
+#endif /* NO_AES */
+
+#ifndef NO_DES3
+static int wolfsslDes3CbcEncrypt(WolfsslCipher* cipher, byte* out,
+                                                    const byte* in, word32 sz)
+{
+    return wc_Des3_CbcEncrypt(&cipher->ctx.des3, out, in, sz) == 0 ? 0 :
+                                                                ENCRYPT_ERROR;
+}
+
+static int wolfsslDes3CbcDecrypt(WolfsslCipher* cipher, byte* out,
+                                                    const byte* in, word32 sz)
+{
+    return wc_Des3_CbcDecrypt(&cipher->ctx.des3, out, in, sz) == 0 ? 0 :
+                                                                DECRYPT_ERROR;
+}
+#endif /* NO_DES3 */
+
+#ifdef HAVE_CAMELLIA
+static int wolfsslCamelliaCbcEncrypt(WolfsslCipher* cipher, byte* out,
+                                                    const byte* in, word32 sz)
+{
+    wc_CamelliaCbcEncrypt(&cipher->ctx.camellia, out, in, sz);
+    return 0;
+}
+
+static int wolfsslCamelliaCbcDecrypt(WolfsslCipher* cipher, byte* out,
+                                                    const byte* in, word32 sz)
+{
+    wc_CamelliaCbcDecrypt(&cipher->ctx.camellia, out, in, sz);
+    return 0;
+}
+#endif /* HAVE_CAMELLIA */
+
+/*
+ * sets the key schedule and IV once and picks the update function
+ */
+int wolfsslCipherInit(WolfsslCipher* cipher, const char* alg,
+                const char* mode, const byte* key, const byte* iv, int block,
+                char action)
+{
+    /* 3des always took a whole 24 byte key, the others a block's worth */
+    return wolfsslCipherInitEx(cipher, alg, mode, key,
+                    XSTRNCMP(alg, "3des", 4) == 0 ? 168 : block * 8, iv,
+                    block, action);
+}
+
+/*
+ * sets the key schedule of a keyBits key and the IV, and picks the update
+ * function
+ */
+int wolfsslCipherInitEx(WolfsslCipher* cipher, const char* alg,
+                const char* mode, const byte* key, int keyBits,
+                const byte* iv, int block, char action)
+{
+    int ret = FATAL_ERROR;          /* return variable */
+#ifndef NO_DES3
+    byte    des3Key[3*DES_BLOCK_SIZE];  /* k1 k2 k3 from 1, 2 or 3 keys */
+    int     keys;                   /* DES keys in key */
+    int     i;                      /* loop variable */
+#endif
+
+    XMEMSET(cipher, 0, sizeof(WolfsslCipher));
+    cipher->block  = block;
+    cipher->action = action;
+
+#ifndef NO_AES
+    if (XSTRNCMP(alg, "aes", 3) == 0) {
+        if (XSTRNCMP(mode, "cbc", 3) == 0) {
+            ret = wc_AesSetKey(&cipher->ctx.aes, key, keyBits / 8, iv,
+                    action == 'e' ? AES_ENCRYPTION : AES_DECRYPTION);
+            cipher->update = action == 'e' ? wolfsslAesCbcEncrypt :
+                                             wolfsslAesCbcDecrypt;
+        }
+#ifdef WOLFSSL_AES_COUNTER
+        else if (XSTRNCMP(mode, "ctr", 3) == 0) {
+            /* ctr uses the encrypt key schedule both ways */
+            ret = wc_AesSetKeyDirect(&cipher->ctx.aes, key, keyBits / 8, iv,
+                                                               AES_ENCRYPTION);
+            cipher->update = wolfsslAesCtr;
+        }
+#endif
+    }
+#endif
+#ifndef NO_DES3
+    if (XSTRNCMP(alg, "3des", 4) == 0) {
+        /* 56 bits is k1 k1 k1, 112 is k1 k2 k1 and 168 is k1 k2 k3 */
+        keys = keyBits / 56;
+        if (keys < 1 || keys > 3)
+            return FATAL_ERROR;
+        for (i = 0; i < 3; i++)
+            XMEMCPY(des3Key + i * DES_BLOCK_SIZE,
+                    key + (i % keys) * DES_BLOCK_SIZE, DES_BLOCK_SIZE);
+        ret = wc_Des3_SetKey(&cipher->ctx.des3, des3Key, iv,
+                action == 'e' ? DES_ENCRYPTION : DES_DECRYPTION);
+        XMEMSET(des3Key, 0, sizeof(des3Key));
+        cipher->update = action == 'e' ? wolfsslDes3CbcEncrypt :
+                                         wolfsslDes3CbcDecrypt;
+    }
+#endif
+#ifdef HAVE_CAMELLIA
+    if (XSTRNCMP(alg, "camellia", 8) == 0) {
+        if (XSTRNCMP(mode, "cbc", 3) != 0) {
+            printf("Incompatible mode while using Camellia.\n");
+            return FATAL_ERROR;
+        }
+        ret = wc_CamelliaSetKey(&cipher->ctx.camellia, key, keyBits / 8, iv);
+        cipher->update = action == 'e' ? wolfsslCamelliaCbcEncrypt :
+                                         wolfsslCamelliaCbcDecrypt;
+    }
+#endif
+
+    if (ret != 0 || cipher->update == NULL) {
+        printf("Failed to set the %s-%s key.\n", alg, mode);
+        wolfsslCipherFree(cipher);
+        return ret != 0 ? ret : FATAL_ERROR;
+    }
+    return 0;
+}
+
+/*
+ * handles the last chunk of a message, adding or removing the padding
+ */
+int wolfsslCipherFinal(WolfsslCipher* cipher, byte* out, byte* in, int sz,
+                                                                    int padded)
+{
+    int i;                          /* loop variable */
+    int pad = 0;                    /* number of padded bytes */
+    int ret;                        /* return variable */
+
+    if (cipher->action == 'e') {
+        /* pad to end of block, every pad byte holds the pad count */
+        pad = (cipher->block - (sz % cipher->block)) % cipher->block;
+        for (i = sz; i < sz + pad; i++)
+            in[i] = (byte) pad;
+        sz += pad;
+    }
+    else if (sz % cipher->block != 0)
+        return DECRYPT_ERROR;
+
+    ret = cipher->update(cipher, out, in, (word32) sz);
+    if (ret != 0)
+        return ret;
+
+    if (cipher->action == 'd' && padded != 0 && sz > 0) {
+        /* reduces length based on number of padded elements */
+        pad = out[sz - 1];
+        if (pad <= 0 || pad >= cipher->block) {
+            printf("Invalid padding, wrong key or corrupt file.\n");
+            return DECRYPT_ERROR;
+        }
+        sz -= pad;
+    }
+    return sz;
+}
+
+/*
+ * clears the key schedule and running IV
+ */
+void wolfsslCipherFree(WolfsslCipher* cipher)
+{
+    XMEMSET(cipher, 0, sizeof(WolfsslCipher));
+}
@@ -22,71 +22,287 @@
 #include "include/wolfssl.h"
 
 #define SALT_SIZE       8
-#define MAX             1024
 
-int wolfsslDecrypt(char* alg, char* mode, byte* pwdKey, byte* key, int size, 
-        char* in, char* out, byte* iv, int block, int keyType)
+/*
+ * decrypts the length bytes of cipher text found after the salt and iv
+ * straight from the mapped input to the mapped output
+ */
+static int wolfsslDecryptMapped(WolfsslCipher* cipher, WolfsslStream* in,
+                WolfsslStream* out, int64_t header, int64_t length, int chunk,
+                int padded)
 {
-#ifndef NO_AES
-    Aes aes;                            /* aes declaration */
-#endif
+    int64_t pos = 0;                /* bytes of cipher text decrypted */
+    int     n;                      /* bytes in this chunk */
+    int     ret;                    /* return variable */
 
-#ifndef NO_DES3
-    Des3 des3;                          /* 3des declaration */
-#endif
+    ret = wolfsslStreamResize(out, length);
+    if (ret == 0)
+        ret = wolfsslStreamMap(in, 'r');
+    if (ret == 0)
+        ret = wolfsslStreamMap(out, 'w');
 
-#ifdef HAVE_CAMELLIA
-    Camellia camellia;                  /* camellia declaration */
-#endif
+    while (ret == 0 && pos < length) {
+        n = (length - pos < chunk) ? (int)(length - pos) : chunk;
+
+        if (pos + n < length) {
+            ret = wolfsslCipherUpdate(cipher, out->map + pos,
+                                            in->map + header + pos, n);
+            pos += n;
+        }
+        else {
+            /* decrypting never writes to in, the map stays read-only */
+            ret = wolfsslCipherFinal(cipher, out->map + pos,
+                                in->map + header + pos, n, padded);
+            if (ret >= 0) {
+                pos += ret;
+                break;
+            }
+        }
+    }
+
+    wolfsslStreamUnmap(in);
+    wolfsslStreamUnmap(out);
 
-    FILE*  inFile;                      /* input file */
-    FILE*  outFile;                     /* output file */
+    /* drop the padding that was decrypted into the last block */
+    if (ret >= 0 && pos < length)
+        ret = wolfsslStreamResize(out, pos);
+
+    return ret < 0 ? ret : 0;
+}
+
+/* what wolfsslDecryptChunk needs to strip the padding of the last chunk */
+typedef struct WolfsslDecryptCtx {
+    WolfsslCipher* cipher;          /* keyed once for the whole file */
+    int            padded;          /* the salt says there is padding */
+} WolfsslDecryptCtx;
+
+/*
+ * decrypts one chunk in place for wolfsslAsyncRun, returns the bytes left
+ * once the padding of the last chunk is removed
+ */
+static int wolfsslDecryptChunk(void* ctx, byte* buf, int sz, int last)
+{
+    WolfsslDecryptCtx* dec = (WolfsslDecryptCtx*) ctx;
+    int                ret;
+
+    if (last)
+        return wolfsslCipherFinal(dec->cipher, buf, buf, sz, dec->padded);
+
+    ret = wolfsslCipherUpdate(dec->cipher, buf, buf, (word32) sz);
+    return ret != 0 ? ret : sz;
+}
+
+int wolfsslDecrypt(char* alg, char* mode, byte* pwdKey, byte* key, int size, 
+        char* in, char* out, byte* iv, int block, int keyType,
+        const WolfsslIo* io)
+{
+    WolfsslCipher cipher;               /* keyed once for the whole file */
+    WolfsslStream inStream;             /* input file */
+    WolfsslStream outStream;            /* output file */
 
     RNG     rng;                        /* random number generator */
     byte*   input  = NULL;              /* input buffer */
     byte*   output = NULL;              /* output buffer */
     byte    salt[SALT_SIZE] = {0};      /* salt variable */
+    byte    count[KDF_COUNT_SIZE];      /* iterations, big endian */
+    word32  iterations = KDF_ITERATIONS;    /* PBKDF2 count of the file */
 
-    int     currLoopFlag = 1;           /* flag to track the loop */
-    int     lastLoopFlag = 0;           /* flag for last loop */
     int     ret          = 0;           /* return variable */
     int     keyVerify    = 0;           /* verify the key is set */
     int     i            = 0;           /* loop variable */
-    int     pad          = 0;           /* the length to pad */
-    int     length;                     /* length of message */
-    int     tempMax = MAX;              /* equal to MAX until feof */
+    int     tempMax      = 0;           /* bytes in this chunk */
     int     sbSize = SALT_SIZE + block; /* size of salt and iv together */
+    int64_t length;                     /* cipher text bytes left to decrypt */
+    int     chunk = io->chunk;          /* bytes decrypted at a time */
+    double  phase;                      /* start of the phase being timed */
 
     /* opens input file */
-    inFile = fopen(in, "rb");
-    if (inFile == NULL) {
+    if (wolfsslStreamOpen(&inStream, in, 'r') != 0) {
         printf("Input file does not exist.\n");
         return DECRYPT_ERROR;
     }
-    /* opens output file */
 
-    if ((outFile = fopen(out, "wb")) == NULL) {
+    /* read in salt, the iteration count when there is one, and iv */
+    if (wolfsslStreamRead(&inStream, salt, SALT_SIZE) != SALT_SIZE) {
+        printf("Error reading salt.\n");
+        wolfsslStreamClose(&inStream);
+        return FREAD_ERROR;
+    }
+    if (salt[SALT_SIZE-1] == KDF_COUNT_FLAG) {
+        if (wolfsslStreamRead(&inStream, count, KDF_COUNT_SIZE) !=
+                                                            KDF_COUNT_SIZE) {
+            printf("Error reading iteration count.\n");
+            wolfsslStreamClose(&inStream);
+            return FREAD_ERROR;
+        }
+        iterations = 0;
+        for (i = 0; i < KDF_COUNT_SIZE; i++)
+            iterations = (iterations << 8) | count[i];
+        sbSize += KDF_COUNT_SIZE;
+    }
+
+    /* everything after the salt and iv is cipher text */
+    length = inStream.length - sbSize;
+    if (length < 0 || length % block != 0 ||
+                iterations < KDF_MIN_ITERATIONS ||
+                iterations > KDF_MAX_ITERATIONS) {
+        printf("Input file is not a valid encrypted file.\n");
+        wolfsslStreamClose(&inStream);
+        return DECRYPT_ERROR;
+    }
+
+    if (wolfsslStreamRead(&inStream, iv, block) != block) {
+        printf("Error reading iv.\n");
+        wolfsslStreamClose(&inStream);
+        return FREAD_ERROR;
+    }
+
+    /* replicates old pwdKey if pwdKeys match */
+    if (keyType == 1) {
+        phase = wolfsslPhaseStart(io);
+        ret = wc_PBKDF2(key, pwdKey, (int) strlen((const char*)pwdKey), salt,
+                    SALT_SIZE, (int) iterations, KDF_KEY_SIZE(size), SHA256);
+        wolfsslPhaseEnd(io, WOLFSSL_PHASE_KDF, phase);
+        if (ret != 0) {
+            printf("pwdKey set error.\n");
+            wolfsslStreamClose(&inStream);
+            return ENCRYPT_ERROR;
+        }
+    }
+    else if (keyType == 2) {
+        for (i = 0; i < size; i++) {
+
+            /* ensure key is set */
+            if (key[i] == 0 || key[i] == '\0') {
+                continue;
+            }
+            else {
+                keyVerify++;
+            }
+        }
+        if (keyVerify == 0) {
+            printf("the key is all zero's or not set.\n");
+            wolfsslStreamClose(&inStream);
+            return ENCRYPT_ERROR;
+        } 
+    }
+
+#ifdef HAVE_PTHREAD
+    /* ctr is seekable and cbc decryption only needs the previous cipher
+     * text block, so the workers each take a range of the file
+     */
+    if (io->threads > 1) {
+        WolfsslParallel job;
+
+        if (wolfsslStreamOpen(&outStream, out, 'w') != 0) {
+            printf("Error creating output file.\n");
+            wolfsslStreamClose(&inStream);
+            return DECRYPT_ERROR;
+        }
+
+        XMEMSET(&job, 0, sizeof(job));
+        job.alg       = alg;
+        job.mode      = mode;
+        job.key       = key;
+        job.iv        = iv;
+        job.block     = block;
+        job.action    = 'd';
+        job.in        = &inStream;
+        job.out       = &outStream;
+        job.inOffset  = sbSize;
+        job.outOffset = 0;
+        job.length    = length;
+        job.pad       = 0;
+        job.chunk     = chunk;
+        job.threads   = io->threads;
+
+        ret = wolfsslParallelCrypt(&job);
+
+        /* padding stays on the last block, its count is the last byte */
+        if (ret == 0 && length > 0 && salt[0] != 0) {
+            if (job.last == 0 || job.last >= block) {
+                printf("Invalid padding, wrong key or corrupt file.\n");
+                ret = DECRYPT_ERROR;
+            }
+            else
+                ret = wolfsslStreamResize(&outStream, length - job.last);
+        }
+
+        wolfsslStreamClose(&inStream);
+        wolfsslStreamClose(&outStream);
+        XMEMSET(key, 0, size);
+        return ret;
+    }
+#endif
+
+    /* sets the key once, the cipher carries its state across chunks */
+    ret = wolfsslCipherInit(&cipher, alg, mode, key, iv, block, 'd');
+    if (ret != 0) {
+        wolfsslStreamClose(&inStream);
+        return ret;
+    }
+
+    /* opens output file */
+    if (wolfsslStreamOpen(&outStream, out, 'w') != 0) {
         printf("Error creating output file.\n");
+        wolfsslCipherFree(&cipher);
+        wolfsslStreamClose(&inStream);
         return DECRYPT_ERROR; 
     }
 
-    /* find end of file for length */
-    fseek(inFile, 0, SEEK_END);
-    length = (int) ftell(inFile);
-    fseek(inFile, 0, SEEK_SET);
+    /* map both files and skip the buffers entirely */
+    if (io->mmap == 1) {
+        ret = wolfsslDecryptMapped(&cipher, &inStream, &outStream, sbSize,
+                                                length, chunk, salt[0] != 0);
+        if (ret != 0)
+            printf("Error decrypting mapped input.\n");
 
-    /* if there is a remainder, 
-     * round up else no round 
-     */
-    if (length % MAX > 0) {
-        lastLoopFlag = (length/MAX) + 1;
+        wolfsslCipherFree(&cipher);
+        wolfsslStreamClose(&inStream);
+        wolfsslStreamClose(&outStream);
+        XMEMSET(key, 0, size);
+        return ret;
     }
-    else {
-        lastLoopFlag =  length/MAX;
+
+    /* overlap reading and writing with decryption */
+    if (io->backend != WOLFSSL_IO_SYNC) {
+        WolfsslAsync      job;
+        WolfsslDecryptCtx dec;
+
+        dec.cipher = &cipher;
+        dec.padded = salt[0] != 0;
+
+        XMEMSET(&job, 0, sizeof(job));
+        job.in        = &inStream;
+        job.out       = &outStream;
+        job.inOffset  = sbSize;
+        job.outOffset = 0;
+        job.length    = length;
+        job.chunk     = chunk;
+        job.func      = wolfsslDecryptChunk;
+        job.ctx       = &dec;
+
+        ret = wolfsslAsyncRun(&job, io->backend);
+        if (ret != 0)
+            printf("Error decrypting input.\n");
+
+        wolfsslCipherFree(&cipher);
+        wolfsslStreamClose(&inStream);
+        wolfsslStreamClose(&outStream);
+        XMEMSET(key, 0, size);
+        return ret;
     }
 
-    input = (byte*) malloc(MAX);
-    output = (byte*) malloc(MAX);
+    input = wolfsslBufAlloc(chunk);
+    output = wolfsslBufAlloc(chunk);
+    if (input == NULL || output == NULL) {
+        printf("Failed to create chunk buffers\n");
+        wolfsslCipherFree(&cipher);
+        wolfsslStreamClose(&inStream);
+        wolfsslStreamClose(&outStream);
+        wolfsslFreeBins(input, output, NULL, NULL, NULL);
+        return MEMORY_E;
+    }
 
     wc_InitRng(&rng);
 
@@ -94,154 +310,53 @@ int wolfsslDecrypt(char* alg, char* mode, byte* pwdKey, byte* key, int size,
      * is there to the input buffer 
      */
     while ( length > 0 ) {
+        tempMax = (length < chunk) ? (int) length : chunk;
 
-        /* On first loop only read in salt and iv */
-        if (currLoopFlag == 1) {
-            if ( (int) fread (salt, 1, SALT_SIZE, inFile) != SALT_SIZE) {
-                printf("Error reading salt.\n");
-                wolfsslFreeBins(input, output, NULL, NULL, NULL);
-                return FREAD_ERROR;
-            }
-
-            if ( (int) fread (iv, 1, block, inFile) != block) {
-                printf("Error reading salt.\n");
-                wolfsslFreeBins(input, output, NULL, NULL, NULL);
-                return FREAD_ERROR;
-            } 
-            /* replicates old pwdKey if pwdKeys match */
-            if (keyType == 1) {
-                if (wc_PBKDF2(key, pwdKey, (int) strlen((const char*)pwdKey), salt, 
-                            SALT_SIZE, 4096, size, SHA256) != 0) {
-                    printf("pwdKey set error.\n");
-                    wolfsslFreeBins(input, output, NULL, NULL, NULL);
-                    return ENCRYPT_ERROR;
-                }
-            }
-            else if (keyType == 2) {
-                for (i = 0; i < size; i++) {
-
-                    /* ensure key is set */
-                    if (key[i] == 0 || key[i] == '\0') {
-                        continue;
-                    }
-                    else {
-                        keyVerify++;
-                    }
-                }
-                if (keyVerify == 0) {
-                    printf("the key is all zero's or not set.\n");
-                    wolfsslFreeBins(input, output, NULL, NULL, NULL);
-                    return ENCRYPT_ERROR;
-                } 
-            }
-        }
-
-        /* Read in 1kB */
-        if ((ret = (int) fread(input, 1, MAX, inFile)) != MAX) {
-            if (feof(inFile)) {
-                tempMax = ret;
-            }
-            else {
-                printf("Input file does not exist.\n");
-                wolfsslFreeBins(input, output, NULL, NULL, NULL);
-                return FREAD_ERROR;
-            }
+        /* Read in a chunk */
+        phase = wolfsslPhaseStart(io);
+        ret = wolfsslStreamRead(&inStream, input, tempMax);
+        wolfsslPhaseEnd(io, WOLFSSL_PHASE_READ, phase);
+        if (ret != tempMax) {
+            printf("Error reading input file.\n");
+            ret = FREAD_ERROR;
+            break;
         }
+        length -= tempMax;
 
-        /* sets pwdKey decrypts the message to ouput from input length */
-#ifndef NO_AES
-        if (XSTRNCMP(alg, "aes", 3) == 0) {
-            if (XSTRNCMP(mode, "cbc", 3) == 0) {
-                ret = wc_AesSetKey(&aes, key, AES_BLOCK_SIZE, iv, AES_DECRYPTION);
-                if (ret != 0) {
-                    fclose(inFile);
-                    fclose(outFile);
-                    wolfsslFreeBins(input, output, NULL, NULL, NULL);
-                    return ret;
-                }
-                ret = wc_AesCbcDecrypt(&aes, output, input, tempMax);
-                if (ret != 0) {
-                    fclose(inFile);
-                    fclose(outFile);
-                    wolfsslFreeBins(input, output, NULL, NULL, NULL);
-                    return DECRYPT_ERROR;
-                }
-            }  
-#ifdef WOLFSSL_AES_COUNTER
-            else if (XSTRNCMP(mode, "ctr", 3) == 0) {
-                /* if mode is ctr */
-                wc_AesSetKeyDirect(&aes, key, AES_BLOCK_SIZE, iv, AES_ENCRYPTION);
-                wc_AesCtrEncrypt(&aes, output, input, tempMax);
-            }
-#endif
-        }
-#endif
-#ifndef NO_DES3
-        if (XSTRNCMP(alg, "3des", 4) == 0) {
-            ret = wc_Des3_SetKey(&des3, key, iv, DES_DECRYPTION);
-            if (ret != 0) {
-                fclose(inFile);
-                fclose(outFile);
-                wolfsslFreeBins(input, output, NULL, NULL, NULL);
-                return ret;
-            }
-            ret = wc_Des3_CbcDecrypt(&des3, output, input, tempMax);
-            if (ret != 0){
-                fclose(inFile);
-                fclose(outFile);
-                wolfsslFreeBins(input, output, NULL, NULL, NULL);
-                return DECRYPT_ERROR;
-            }
-        }
-#endif
-#ifdef HAVE_CAMELLIA
-        if (XSTRNCMP(alg, "camellia", 8) == 0) {
-            ret = wc_CamelliaSetKey(&camellia, key, block, iv);
-            if (ret != 0) {
-                fclose(inFile);
-                fclose(outFile);
-                wolfsslFreeBins(input, output, NULL, NULL, NULL);
-                return ret;
-            }
-            wc_CamelliaCbcDecrypt(&camellia, output, input, tempMax);
+        /* decrypts the message to ouput from input, removing the padding
+         * from the last chunk when the salt says there is some
+         */
+        phase = wolfsslPhaseStart(io);
+        if (length > 0)
+            ret = wolfsslCipherUpdate(&cipher, output, input, tempMax);
+        else {
+            ret = wolfsslCipherFinal(&cipher, output, input, tempMax,
+                                                                salt[0] != 0);
+            tempMax = ret;
+            ret = ret < 0 ? ret : 0;
         }
-#endif
-        if (currLoopFlag == lastLoopFlag) {
-            if (salt[0] != 0) {
-                /* reduces length based on number of padded elements  */
-                pad = output[tempMax-1];
-                /* adjust length for padded bytes and salt size */
-                length -= pad + sbSize;
-                /* reset tempMax for smaller decryption */
-                fwrite(output, 1, length, outFile);
-                break;
-            }
-            else {
-                fwrite(output, 1, tempMax, outFile);
+        wolfsslPhaseEnd(io, WOLFSSL_PHASE_CRYPTO, phase);
+        if (ret != 0)
+            break;
 
-                XMEMSET(input, 0, tempMax);
-                XMEMSET(output, 0, tempMax);
-                break;
-            }
-        } 
         /* writes output to the outFile */
-        fwrite(output, 1, tempMax, outFile);
-
-        XMEMSET(input, 0, tempMax);
-        XMEMSET(output, 0, tempMax);
-
-        currLoopFlag++;
-        length -= tempMax;
+        phase = wolfsslPhaseStart(io);
+        ret = wolfsslStreamWrite(&outStream, output, tempMax);
+        wolfsslPhaseEnd(io, WOLFSSL_PHASE_WRITE, phase);
+        if (ret != 0) {
+            printf("Error writing output file.\n");
+            ret = FWRITE_ERROR;
+            break;
+        }
     }
-    /* closes the opened files and frees memory */
-    XMEMSET(input, 0, MAX);
-    XMEMSET (output, 0, MAX);
+    /* closes the opened files and frees memory, wiping the chunks */
     wolfsslFreeBins(input, output, NULL, NULL, NULL);
+    wolfsslCipherFree(&cipher);
     XMEMSET(key, 0, size);
     /* Use the wolfssl wc_FreeRng to free rng */
     wc_FreeRng(&rng);
-    fclose(inFile);
-    fclose(outFile);
+    wolfsslStreamClose(&inStream);
+    wolfsslStreamClose(&outStream);
 
-    return 0;
+    return ret;
 }
@@ -22,47 +22,216 @@
 #include "include/wolfssl.h"
 
 #define SALT_SIZE       8
-#define MAX             1024
 
-int wolfsslEncrypt(char* alg, char* mode, byte* pwdKey, byte* key, int size,
-        char* in, char* out, byte* iv, int block, int ivCheck, int inputHex)
+/*
+ * encrypts length bytes straight from the mapped input to the mapped output,
+ * following the salt and iv already written to out
+ */
+static int wolfsslEncryptMapped(WolfsslCipher* cipher, WolfsslStream* in,
+                            WolfsslStream* out, int64_t length, int chunk)
 {
-#ifndef NO_AES
-    Aes aes;                        /* aes declaration */
-#endif
+    byte    tail[2*AES_BLOCK_SIZE]; /* last partial block with padding */
+    int64_t pos    = 0;             /* bytes of input encrypted so far */
+    int64_t header = out->offset;   /* salt and iv at the front of out */
+    int     pad;                    /* number of padded bytes */
+    int     n;                      /* bytes in this chunk */
+    int     ret;                    /* return variable */
+
+    pad = (int) ((cipher->block - (length % cipher->block)) % cipher->block);
+
+    ret = wolfsslStreamResize(out, header + length + pad);
+    if (ret == 0)
+        ret = wolfsslStreamMap(in, 'r');
+    if (ret == 0)
+        ret = wolfsslStreamMap(out, 'w');
+
+    /* whole blocks go from page to page, chunk by chunk */
+    while (ret == 0 && length - pos >= cipher->block) {
+        n = (length - pos < chunk) ? (int)(length - pos) : chunk;
+        n -= n % cipher->block;
+        ret = wolfsslCipherUpdate(cipher, out->map + header + pos,
+                                                        in->map + pos, n);
+        pos += n;
+    }
 
-#ifndef NO_DES3
-    Des3 des3;                      /* 3des declaration */
-#endif
+    /* the input is read-only, so the partial block is padded in tail */
+    if (ret == 0 && pad > 0) {
+        n = (int)(length - pos);
+        XMEMCPY(tail, in->map + pos, n);
+        ret = wolfsslCipherFinal(cipher, out->map + header + pos, tail, n, 0);
+        ret = ret < 0 ? ret : 0;
+        XMEMSET(tail, 0, sizeof(tail));
+    }
 
-#ifdef HAVE_CAMELLIA
-    Camellia camellia;              /* camellia declaration */
-#endif
+    wolfsslStreamUnmap(in);
+    wolfsslStreamUnmap(out);
 
-    FILE*  tempInFile = NULL;       /* if user not provide a file */
-    FILE*  inFile = NULL;           /* input file */
-    FILE*  outFile = NULL;          /* output file */
+    return ret;
+}
 
-    RNG     rng;                    /* random number generator declaration */
+/*
+ * encrypts one chunk in place for wolfsslAsyncRun, padding the last one.
+ * Chunks are a multiple of the block so the padding always fits.
+ */
+static int wolfsslEncryptChunk(void* ctx, byte* buf, int sz, int last)
+{
+    WolfsslCipher* cipher = (WolfsslCipher*) ctx;
+    int            ret;
+
+    if (last)
+        return wolfsslCipherFinal(cipher, buf, buf, sz, 0);
+
+    ret = wolfsslCipherUpdate(cipher, buf, buf, (word32) sz);
+    return ret != 0 ? ret : sz;
+}
 
+/*
+ * reads, encrypts and writes length bytes a chunk at a time, the salt and iv
+ * already written to out. Hex input is two characters for every byte.
+ */
+static int wolfsslEncryptStream(WolfsslCipher* cipher, WolfsslStream* in,
+                            WolfsslStream* out, int64_t length, int inputHex,
+                            const WolfsslIo* io)
+{
     byte*   input = NULL;           /* input buffer */
     byte*   output = NULL;          /* output buffer */
+    char*   inputString = NULL;     /* the input string when using hex */
+    byte*   hexBin = NULL;          /* hex input converted to binary */
+
+    int     ret             = 0;    /* return variable */
+    int     hexRet          = 0;    /* hex -> bin return*/
+    int     readSz          = 0;    /* bytes wanted from the next read */
+    int     chunk       = io->chunk;/* bytes encrypted at a time */
+
+    word32  tempInputL      = 0;    /* temporary input Length */
+    word32  tempMax         = 0;    /* controls encryption amount */
+    double  phase           = 0;    /* start of the phase being timed */
+
+    /* one pair of chunk sized buffers for the whole file */
+    input = wolfsslBufAlloc(chunk);
+    output = wolfsslBufAlloc(chunk);
+    if (inputHex == 1)
+        inputString = (char*) wolfsslBufAlloc(chunk * 2 + 1);
+    if (input == NULL || output == NULL ||
+                                        (inputHex == 1 && inputString == NULL)) {
+        printf("Failed to create chunk buffers\n");
+        wolfsslFreeBins(input, output, (byte*)inputString, NULL, NULL);
+        return MEMORY_E;
+    }
+
+    /* loop, encrypt a chunk at a time till length <= 0 */
+    while (length > 0) {
+        readSz = (length < chunk) ? (int) length : chunk;
+
+        /* Read in a chunk to input[] */
+        phase = wolfsslPhaseStart(io);
+        if (inputHex == 1) {
+            ret = wolfsslStreamRead(in, (byte*)inputString, readSz * 2);
+            if (ret >= 0) {
+                inputString[ret] = '\0';
+                hexRet = wolfsslHexToBin(inputString, &hexBin, &tempInputL,
+                                            NULL, NULL, NULL,
+                                            NULL, NULL, NULL,
+                                            NULL, NULL, NULL);
+                if (hexRet != 0) {
+                    printf("failed during conversion of input,"
+                        " ret = %d\n", hexRet);
+                    ret = hexRet;
+                    break;
+                }
+                XMEMCPY(input, hexBin, tempInputL);
+                wolfsslFreeBins(hexBin, NULL, NULL, NULL, NULL);
+                hexBin = NULL;
+                ret = (int) tempInputL;
+            }
+        }
+        else
+            ret = wolfsslStreamRead(in, input, readSz);
+        wolfsslPhaseEnd(io, WOLFSSL_PHASE_READ, phase);
+
+        if (ret != readSz) {
+            /* otherwise we got a file read error */
+            printf("failed to read input file.\n");
+            ret = FREAD_ERROR;
+            break;
+        }
+        length -= ret;
+
+        /* encrypts the message to ouput from input, padding the end */
+        phase = wolfsslPhaseStart(io);
+        if (length > 0) {
+            tempMax = (word32) ret;
+            ret = wolfsslCipherUpdate(cipher, output, input, tempMax);
+        }
+        else {
+            ret = wolfsslCipherFinal(cipher, output, input, ret, 0);
+            tempMax = (word32) ret;
+            ret = ret < 0 ? ret : 0;
+        }
+        wolfsslPhaseEnd(io, WOLFSSL_PHASE_CRYPTO, phase);
+        if (ret != 0) {
+            printf("failed to encrypt input.\n");
+            ret = ENCRYPT_ERROR;
+            break;
+        }
+
+        /* this method added for visual confirmation of nist test vectors,
+         * automated tests to come soon
+         */
+
+        /* something in the output buffer and using hex */
+        if (output != NULL && inputHex == 1) {
+            int tempi;
+
+            printf("\nUser specified hex input this is a representation of "
+                "what\nis being written to file in hex form.\n\n[ ");
+            for (tempi = 0; tempi < cipher->block; tempi++ ) {
+                printf("%02x", output[tempi]);
+            }
+            printf(" ]\n\n");
+        } /* end visual confirmation */
+
+        /* write the chunk through the already open outFile */
+        phase = wolfsslPhaseStart(io);
+        ret = wolfsslStreamWrite(out, output, tempMax);
+        wolfsslPhaseEnd(io, WOLFSSL_PHASE_WRITE, phase);
+        if (ret != 0) {
+            printf("failed to write to file.\n");
+            ret = FWRITE_ERROR;
+            break;
+        }
+    }
+
+    /* wipes the chunk buffers as it hands them back */
+    wolfsslFreeBins(input, output, (byte*)inputString, NULL, NULL);
+    return ret;
+}
+
+int wolfsslEncrypt(char* alg, char* mode, byte* pwdKey, byte* key, int size,
+        char* in, char* out, byte* iv, int block, int ivCheck, int inputHex,
+        int iterations, const WolfsslIo* io)
+{
+    WolfsslCipher cipher;           /* keyed once for the whole file */
+    FILE*  tempInFile = NULL;       /* if user not provide a file */
+    WolfsslStream inStream;         /* input file */
+    WolfsslStream outStream;        /* output file */
+
+    RNG     rng;                    /* random number generator declaration */
+
     byte    salt[SALT_SIZE] = {0};  /* salt variable */
+    byte    count[KDF_COUNT_SIZE];  /* iterations, big endian */
 
     int     ret             = 0;    /* return variable */
     int     inputLength     = 0;    /* length of input */
-    int     length          = 0;    /* total length */
     int     padCounter      = 0;    /* number of padded bytes */
     int     i               = 0;    /* loop variable */
-    int     hexRet          = 0;    /* hex -> bin return*/
+    int64_t length          = 0;    /* plain text bytes left to encrypt */
+    int     chunk       = io->chunk;/* bytes encrypted at a time */
 
-    word32  tempInputL      = 0;    /* temporary input Length */
-    word32  tempMax         = MAX;  /* controls encryption amount */
+    double  phase           = 0;    /* start of the phase being timed */
 
-    char    inputString[MAX];       /* the input string */
     char*   userInputBuffer = NULL; /* buffer when input is not a file */
 
-
     if (access (in, F_OK) == -1) {
         printf("file did not exist, encrypting string following \"-i\""
                 "instead.\n");
@@ -84,29 +253,31 @@ int wolfsslEncrypt(char* alg, char* mode, byte* pwdKey, byte* key, int size,
     }
 
     /* open the inFile in read mode */
-    inFile = fopen(in, "rb");
-
-    /* find length */
-    fseek(inFile, 0, SEEK_END);
-    inputLength = (int) ftell(inFile);
-    fseek(inFile, 0, SEEK_SET);
+    if (wolfsslStreamOpen(&inStream, in, 'r') != 0) {
+        printf("failed to open input file.\n");
+        return FREAD_ERROR;
+    }
 
-    length = inputLength;
+    /* hex input is two characters for every byte encrypted */
+    length = inStream.length;
+    if (inputHex == 1)
+        length /= 2;
 
     /* Start up the random number generator */
     ret = (int) wc_InitRng(&rng);
     if (ret != 0) {
         printf("Random Number Generator failed to start.\n");
+        wolfsslStreamClose(&inStream);
         return ret;
     }
 
-    /* pads the length until it matches a block,
-     * and increases pad number
-     */
-    while (length % block != 0) {
-        length++;
-        padCounter++;
-    }
+    /* number of bytes needed to pad the length to a full block */
+    padCounter = (int) ((block - (length % block)) % block);
+
+    /* nothing below is open yet, so the cleanup at the end is always safe */
+    XMEMSET(&cipher, 0, sizeof(cipher));
+    XMEMSET(&outStream, 0, sizeof(outStream));
+    outStream.fd = -1;
 
     /* if the iv was not explicitly set,
      * generate an iv and use the pwdKey
@@ -115,191 +286,109 @@ int wolfsslEncrypt(char* alg, char* mode, byte* pwdKey, byte* key, int size,
         /* IV not set, generate it */
         ret = wc_RNG_GenerateBlock(&rng, iv, block);
 
-        if (ret != 0) {
-            return ret;
-        }
-
         /* stretches pwdKey to fit size based on wolfsslGetAlgo() */
-        ret = wolfsslGenKey(&rng, pwdKey, size, salt, padCounter);
-
-        if (ret != 0) {
-            printf("failed to set pwdKey.\n");
-            return ret;
+        if (ret == 0) {
+            phase = wolfsslPhaseStart(io);
+            ret = wolfsslGenKey(&rng, pwdKey, size, salt, padCounter,
+                                                                iterations);
+            wolfsslPhaseEnd(io, WOLFSSL_PHASE_KDF, phase);
+            if (ret != 0)
+                printf("failed to set pwdKey.\n");
         }
+
         /* move the generated pwdKey to "key" for encrypting */
-        for (i = 0; i < size; i++) {
+        for (i = 0; ret == 0 && i < size; i++) {
             key[i] = pwdKey[i];
         }
     }
 
-    /* open the outFile in write mode */
-    outFile = fopen(out, "wb");
-    fwrite(salt, 1, SALT_SIZE, outFile);
-    fwrite(iv, 1, block, outFile);
-    fclose(outFile);
-
-    /* malloc 1kB buffers */
-    input = (byte*) malloc(MAX);
-    output = (byte*) malloc(MAX);
+    /* open the outFile in write mode, it stays open until we are done */
+    if (ret == 0 && wolfsslStreamOpen(&outStream, out, 'w') != 0) {
+        printf("failed to open output file.\n");
+        ret = FWRITE_ERROR;
+    }
+    /* a count other than the default follows the salt */
+    for (i = 0; i < KDF_COUNT_SIZE; i++)
+        count[i] = (byte) (iterations >> (8 * (KDF_COUNT_SIZE - 1 - i)));
+    if (ret == 0 && (wolfsslStreamWrite(&outStream, salt, SALT_SIZE) != 0 ||
+        (salt[SALT_SIZE-1] == KDF_COUNT_FLAG &&
+         wolfsslStreamWrite(&outStream, count, KDF_COUNT_SIZE) != 0) ||
+        wolfsslStreamWrite(&outStream, iv, block) != 0)) {
+        printf("failed to write to file.\n");
+        ret = FWRITE_ERROR;
+    }
 
-    /* loop, encrypt 1kB at a time till length <= 0 */
-    while (length > 0) {
-        /* Read in 1kB to input[] */
-        if (inputHex == 1)
-            ret = (int) fread(inputString, 1, MAX, inFile);
-        else
-            ret = (int) fread(input, 1, MAX, inFile);
-
-        if (ret != MAX) {
-            /* check for end of file */
-            if (feof(inFile)) {
-
-                /* hex or ascii */
-                if (inputHex == 1) {
-                    hexRet = wolfsslHexToBin(inputString, &input,
-                                                &tempInputL,
-                                                NULL, NULL, NULL,
-                                                NULL, NULL, NULL,
-                                                NULL, NULL, NULL);
-                     if (hexRet != 0) {
-                        printf("failed during conversion of input,"
-                            " ret = %d\n", hexRet);
-                        return hexRet;
-                    }
-                }/* end hex or ascii */
-
-                /* pad to end of block */
-                for (i = ret ; i < (ret + padCounter); i++) {
-                    input[i] = padCounter;
-                }
-                /* adjust tempMax for less than 1kB encryption */
-                tempMax = ret + padCounter;
-            }
-            else { /* otherwise we got a file read error */
-                wolfsslFreeBins(input, output, NULL, NULL, NULL);
-                return FREAD_ERROR;
-            }/* End feof check */
-        }/* End fread check */
-
-        /* sets key encrypts the message to ouput from input */
-#ifndef NO_AES
-        if (XSTRNCMP(alg, "aes", 3) == 0) {
-            if (XSTRNCMP(mode, "cbc", 3) == 0) {
-                ret = wc_AesSetKey(&aes, key, AES_BLOCK_SIZE, iv, AES_ENCRYPTION);
-                if (ret != 0) {
-                    printf("wc_AesSetKey failed.\n");
-                    wolfsslFreeBins(input, output, NULL, NULL, NULL);
-                    return ret;
-                }
-                ret = wc_AesCbcEncrypt(&aes, output, input, tempMax);
-                if (ret != 0) {
-                    printf("wc_AesCbcEncrypt failed.\n");
-                    wolfsslFreeBins(input, output, NULL, NULL, NULL);
-                    return ENCRYPT_ERROR;
-                }
-            }
-#ifdef WOLFSSL_AES_COUNTER
-            else if (XSTRNCMP(mode, "ctr", 3) == 0) {
-                /* if mode is ctr */
-                wc_AesSetKeyDirect(&aes, key, AES_BLOCK_SIZE, iv, AES_ENCRYPTION);
-                wc_AesCtrEncrypt(&aes, output, input, tempMax);
-            }
-#endif
-        }
+#ifdef HAVE_PTHREAD
+    /* ctr is seekable, so the workers each take a range of the file */
+    if (ret == 0 && io->threads > 1 && inputHex == 0 &&
+                                            XSTRNCMP(mode, "ctr", 3) == 0) {
+        WolfsslParallel job;
+
+        XMEMSET(&job, 0, sizeof(job));
+        job.alg       = alg;
+        job.mode      = mode;
+        job.key       = key;
+        job.iv        = iv;
+        job.block     = block;
+        job.action    = 'e';
+        job.in        = &inStream;
+        job.out       = &outStream;
+        job.inOffset  = 0;
+        job.outOffset = outStream.offset;
+        job.length    = length;
+        job.pad       = padCounter;
+        job.chunk     = chunk;
+        job.threads   = io->threads;
+
+        ret = wolfsslParallelCrypt(&job);
+        if (ret != 0)
+            printf("failed to encrypt input.\n");
+    }
+    else
 #endif
-#ifndef NO_DES3
-        if (XSTRNCMP(alg, "3des", 4) == 0) {
-            ret = wc_Des3_SetKey(&des3, key, iv, DES_ENCRYPTION);
-            if (ret != 0) {
-                printf("wc_Des3_SetKey failed.\n");
-                wolfsslFreeBins(input, output, NULL, NULL, NULL);
-                return ret;
-            }
-            ret = wc_Des3_CbcEncrypt(&des3, output, input, tempMax);
-            if (ret != 0) {
-                printf("wc_Des3_cbcEncrypt failed.\n");
-                wolfsslFreeBins(input, output, NULL, NULL, NULL);
-                return ENCRYPT_ERROR;
-            }
+    if (ret == 0) {
+        /* sets the key once, the cipher carries its state across chunks */
+        ret = wolfsslCipherInit(&cipher, alg, mode, key, iv, block, 'e');
+
+        if (ret == 0 && io->mmap == 1 && inputHex == 0) {
+            /* map both files and skip the buffers entirely */
+            ret = wolfsslEncryptMapped(&cipher, &inStream, &outStream,
+                                                                length, chunk);
+            if (ret != 0)
+                printf("failed to encrypt mapped input.\n");
         }
-#endif
-#ifdef HAVE_CAMELLIA
-        if (XSTRNCMP(alg, "camellia", 8) == 0) {
-            ret = wc_CamelliaSetKey(&camellia, key, block, iv);
-            if (ret != 0) {
-                printf("CamelliaSetKey failed.\n");
-                wolfsslFreeBins(input, output, NULL, NULL, NULL);
-                return ret;
-            }
-            if (XSTRNCMP(mode, "cbc", 3) == 0) {
-                wc_CamelliaCbcEncrypt(&camellia, output, input, tempMax);
-            }
-            else {
-                printf("Incompatible mode while using Camellia.\n");
-                wolfsslFreeBins(input, output, NULL, NULL, NULL);
-                return FATAL_ERROR;
-            }
+        else if (ret == 0 && io->backend != WOLFSSL_IO_SYNC && inputHex == 0) {
+            /* overlap reading and writing with encryption */
+            WolfsslAsync job;
+
+            XMEMSET(&job, 0, sizeof(job));
+            job.in        = &inStream;
+            job.out       = &outStream;
+            job.inOffset  = 0;
+            job.outOffset = outStream.offset;
+            job.length    = length;
+            job.chunk     = chunk;
+            job.func      = wolfsslEncryptChunk;
+            job.ctx       = &cipher;
+
+            ret = wolfsslAsyncRun(&job, io->backend);
+            if (ret != 0)
+                printf("failed to encrypt input.\n");
         }
-#endif /* HAVE_CAMELLIA */
-
-        /* this method added for visual confirmation of nist test vectors,
-         * automated tests to come soon
-         */
-
-        /* something in the output buffer and using hex */
-        if (output != NULL && inputHex == 1) {
-            int tempi;
-
-            printf("\nUser specified hex input this is a representation of "
-                "what\nis being written to file in hex form.\n\n[ ");
-            for (tempi = 0; tempi < block; tempi++ ) {
-                printf("%02x", output[tempi]);
-            }
-            printf(" ]\n\n");
-        } /* end visual confirmation */
-
-        /* Open the outFile in append mode */
-        outFile = fopen(out, "ab");
-        ret = (int) fwrite(output, 1, tempMax, outFile);
-
-        if (ferror(outFile)) {
-            printf("failed to write to file.\n");
-            if (input != NULL)
-                XMEMSET(input, 0, tempMax);
-            if (output != NULL)
-                XMEMSET(output, 0, tempMax);
-            wolfsslFreeBins(input, output, NULL, NULL, NULL);
-            return FWRITE_ERROR;
-        }
-        if (ret > MAX) {
-            printf("Wrote too much to file.\n");
-            if (input != NULL)
-                XMEMSET(input, 0, tempMax);
-            if (output != NULL)
-                XMEMSET(output, 0, tempMax);
-            wolfsslFreeBins(input, output, NULL, NULL, NULL);
-            return FWRITE_ERROR;
-        }
-        /* close the outFile */
-        fclose(outFile);
-
-        length -= tempMax;
-        if (length < 0)
-            printf("length went past zero.\n");
-        if (input != NULL)
-            XMEMSET(input, 0, tempMax);
-        if (output != NULL)
-            XMEMSET(output, 0, tempMax);
+        else if (ret == 0)
+            ret = wolfsslEncryptStream(&cipher, &inStream, &outStream, length,
+                                                                inputHex, io);
     }
 
-    /* closes the opened files and frees the memory */
-    fclose(inFile);
+    /* every exit once the rng is up: closes the opened files, wipes the key
+     * and iv and frees the rng
+     */
+    wolfsslCipherFree(&cipher);
+    wolfsslStreamClose(&inStream);
+    wolfsslStreamClose(&outStream);
     XMEMSET(key, 0, size);
     XMEMSET(iv, 0 , block);
-    XMEMSET(alg, 0, size);
-    XMEMSET(mode, 0 , block);
     /* Use the wolfssl free for rng */
     wc_FreeRng(&rng);
-    wolfsslFreeBins(input, output, NULL, NULL, NULL);
-    return 0;
+    return ret;
 }
@@ -0,0 +1,263 @@
+/* wolfsslParallel.c
+ *
+ * Copyright (C) 2006-2015 wolfSSL Inc.
+ *
+ * This file is part of wolfSSL. (formerly known as CyaSSL)
+ *
+ * wolfSSL is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfSSL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "include/wolfssl.h"
+
+#ifdef HAVE_PTHREAD
+
+#define RANGES_PER_THREAD 8      /* pieces each worker's share splits into */
+
+/* ranges of a WolfsslParallel job and the pool they run on */
+typedef struct WolfsslSplit {
+    WolfsslParallel*      job;      /* the job being split */
+    WolfsslPool           pool;     /* runs the ranges */
+    struct WolfsslRange*  ranges;   /* room for every range */
+    pthread_mutex_t       lock;     /* guards count */
+    int                   count;    /* ranges on the pool, set up in full */
+    int                   max;      /* room in ranges */
+    int64_t               grain;    /* ranges up to this size aren't split */
+} WolfsslSplit;
+
+/* one contiguous range of a WolfsslParallel job */
+typedef struct WolfsslRange {
+    WolfsslSplit* split;        /* the job this range belongs to */
+    WolfsslTask   task;         /* the range on the pool */
+    int64_t       start;        /* first byte of the range */
+    int64_t       end;          /* one past the last byte of the range */
+} WolfsslRange;
+
+/*
+ * sets ctr to the counter for the block at index blocks of the message
+ */
+static void wolfsslCtrOffset(byte* ctr, const byte* iv, int64_t blocks)
+{
+    int     i;                          /* loop variable */
+    word32  carry = 0;                  /* carry into the next byte */
+    word64  add   = (word64) blocks;    /* big endian amount to add */
+
+    for (i = AES_BLOCK_SIZE - 1; i >= 0; i--) {
+        carry += iv[i] + (word32)(add & 0xff);
+        ctr[i] = (byte) carry;
+        carry >>= 8;
+        add >>= 8;
+    }
+}
+
+/*
+ * en/de crypts start to end of the message in chunk sized pieces
+ */
+static int wolfsslParallelPart(WolfsslParallel* job, int64_t start,
+                                                                int64_t end)
+{
+    WolfsslCipher    cipher;            /* this range's own key schedule */
+
+    byte    iv[2*AES_BLOCK_SIZE];       /* IV or counter, fits 3des' 24 */
+    byte*   input  = NULL;              /* chunk read from the input */
+    byte*   output = NULL;              /* chunk written to the output */
+    int64_t pos    = start;             /* current byte in the message */
+    int     n;                          /* bytes in this chunk */
+    int     avail;                      /* of those, bytes from the input */
+    int     ret;                        /* return variable */
+    int     ivSz   = job->block;        /* cipher block that chains */
+
+#ifndef NO_DES3
+    /* 3des works on 24 bytes at a time but chains 8 byte DES blocks */
+    if (XSTRNCMP(job->alg, "3des", 4) == 0)
+        ivSz = DES_BLOCK_SIZE;
+#endif
+
+    XMEMSET(iv, 0, sizeof(iv));
+    if (XSTRNCMP(job->mode, "ctr", 3) == 0) {
+        /* ctr is seekable, start the counter at this range's first block */
+        wolfsslCtrOffset(iv, job->iv, start / job->block);
+    }
+    else if (job->action == 'd' && start > 0) {
+        /* cbc decryption of a block only needs the cipher text block before
+         * it, which becomes the IV of this range
+         */
+        if (wolfsslStreamReadAt(job->in, iv, ivSz,
+                                    job->inOffset + start - ivSz) != ivSz)
+            return FREAD_ERROR;
+    }
+    else if (job->action == 'd')
+        XMEMCPY(iv, job->iv, job->block);
+    else {
+        /* cbc encryption chains through every block, it can't be split */
+        return FATAL_ERROR;
+    }
+
+    ret = wolfsslCipherInit(&cipher, job->alg, job->mode, job->key, iv,
+                                                    job->block, job->action);
+    if (ret != 0)
+        return ret;
+
+    /* ranges come and go, their buffers are recycled between them */
+    input  = wolfsslBufAlloc(job->chunk);
+    output = wolfsslBufAlloc(job->chunk);
+    if (input == NULL || output == NULL)
+        ret = MEMORY_E;
+
+    while (ret == 0 && pos < end) {
+        if (wolfsslPoolCancelled(NULL)) {
+            ret = POOL_CANCELLED;
+            break;
+        }
+        n = (end - pos < job->chunk) ? (int)(end - pos) : job->chunk;
+        avail = (job->length - pos < n) ? (int)(job->length - pos) : n;
+        if (avail < 0)
+            avail = 0;
+
+        if (wolfsslStreamReadAt(job->in, input, avail,
+                                            job->inOffset + pos) != avail) {
+            ret = FREAD_ERROR;
+            break;
+        }
+        /* only the range holding the end of the message sees padding */
+        XMEMSET(input + avail, job->pad, n - avail);
+
+        ret = wolfsslCipherUpdate(&cipher, output, input, (word32) n);
+        if (ret != 0)
+            break;
+
+        if (wolfsslStreamWriteAt(job->out, output, n,
+                                            job->outOffset + pos) != 0) {
+            ret = FWRITE_ERROR;
+            break;
+        }
+        pos += n;
+        if (pos == job->length + job->pad)
+            job->last = output[n - 1];
+    }
+
+    wolfsslFreeBins(input, output, NULL, NULL, NULL);
+    wolfsslCipherFree(&cipher);
+    XMEMSET(iv, 0, sizeof(iv));
+
+    return ret;
+}
+
+/*
+ * one range, a pool task. While the range is big its back half is spawned
+ * for an idle worker to steal, so the biggest pieces are stolen first and
+ * no worker is left with a long tail while the others wait.
+ */
+static int wolfsslParallelRange(void* arg, int worker)
+{
+    WolfsslRange*    range = (WolfsslRange*) arg;
+    WolfsslSplit*    split = range->split;
+    WolfsslRange*    half;              /* the back half spawned */
+    int64_t          mid;               /* where the range splits */
+
+    while (range->end - range->start > split->grain) {
+        /* the slot is counted only once spawned, so the thread waiting on
+         * every counted range never sees one half set up
+         */
+        pthread_mutex_lock(&split->lock);
+        if (split->count >= split->max) {
+            pthread_mutex_unlock(&split->lock);
+            break;
+        }
+        mid = range->start + (range->end - range->start) / 2 /
+                                    split->job->block * split->job->block;
+
+        half = &split->ranges[split->count];
+        half->split = split;
+        half->start = mid;
+        half->end   = range->end;
+        range->end  = mid;
+        wolfsslPoolSpawn(&split->pool, worker, &half->task,
+                                        wolfsslParallelRange, NULL, half);
+        split->count++;
+        pthread_mutex_unlock(&split->lock);
+    }
+
+    return wolfsslParallelPart(split->job, range->start, range->end);
+}
+
+/*
+ * runs a seekable en/de cryption as ranges that split across the pool's
+ * workers as they go idle
+ */
+int wolfsslParallelCrypt(WolfsslParallel* job)
+{
+    WolfsslSplit split;                         /* shared by the ranges */
+
+    int64_t total   = job->length + job->pad;   /* bytes to produce */
+    int     threads = job->threads;             /* workers to start */
+    int     ret     = 0;                        /* return variable */
+    int     count;                              /* ranges spawned so far */
+    int     i;                                  /* loop variable */
+
+    if (total % job->block != 0)
+        return FATAL_ERROR;
+
+    /* every worker gets at least a chunk so small files stay cheap */
+    if (threads > MAX_THREADS)
+        threads = MAX_THREADS;
+    if (total / job->chunk < threads)
+        threads = (int)(total / job->chunk);
+    if (threads < 1)
+        threads = 1;
+
+    /* the output is sized up front so workers can write anywhere in it */
+    ret = wolfsslStreamResize(job->out, job->outOffset + total);
+    if (ret != 0)
+        return ret;
+
+    XMEMSET(&split, 0, sizeof(split));
+    split.job   = job;
+    split.grain = total / ((int64_t) threads * RANGES_PER_THREAD);
+    if (split.grain < job->chunk)
+        split.grain = job->chunk;
+    /* halving stops above half the grain, bounding the ranges made */
+    split.max    = (int)(2 * (total / split.grain)) + 2;
+    split.ranges = (WolfsslRange*) calloc(split.max, sizeof(WolfsslRange));
+    if (split.ranges == NULL)
+        return MEMORY_E;
+
+    split.count = 1;
+    split.ranges[0].split = &split;
+    split.ranges[0].end   = total;
+    pthread_mutex_init(&split.lock, NULL);
+
+    wolfsslPoolInit(&split.pool, threads, 1);
+    wolfsslPoolSubmit(&split.pool, &split.ranges[0].task,
+                            wolfsslParallelRange, NULL, &split.ranges[0]);
+
+    /* once every range handed out is done none is running to split more */
+    for (i = 0; ; i++) {
+        pthread_mutex_lock(&split.lock);
+        count = split.count;
+        pthread_mutex_unlock(&split.lock);
+        if (i >= count)
+            break;
+        if (wolfsslPoolWait(&split.pool, &split.ranges[i].task) != 0 &&
+                                                                    ret == 0)
+            ret = split.ranges[i].task.ret;
+    }
+    wolfsslPoolFree(&split.pool);
+    pthread_mutex_destroy(&split.lock);
+    free(split.ranges);
+
+    return ret;
+}
+
+#endif /* HAVE_PTHREAD */
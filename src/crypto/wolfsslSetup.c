@@ -52,8 +52,14 @@ int wolfsslSetup(int argc, char** argv, char action)
     int      keyType    =   0;  /* tells Decrypt which key it will be using
                                  * 1 = password based key, 2 = user set key
                                  */
+    int64_t  chunkArg = DEFAULT_CHUNK; /* -chunk as given by the user */
+    int      kdfIter = KDF_ITERATIONS;  /* PBKDF2 iterations when encrypting */
+    double   kdfTarget  =   0;  /* -kdf-target-ms, 0 without it */
+    /* chunk, threads, mmap, -io and no phase timing */
+    WolfsslIo io = {0, 1, 0, WOLFSSL_IO_SYNC, NULL};
     word32   ivSize     =   0;  /* IV if provided should be 2*block */
     word32   numBits    =   0;  /* number of bits in argument from the user */
+    size_t   pwdLen     =   0;  /* -pwd bytes kept, a NUL always follows */
 
     if (action == 'e')
         eCheck = 1;
@@ -79,9 +85,14 @@ int wolfsslSetup(int argc, char** argv, char action)
     block = wolfsslGetAlgo(name, &alg, &mode, &size);
 
     if (block != FATAL_ERROR) {
-        pwdKey = (byte*) malloc(size);
-        iv = (byte*) malloc(block);
-        key = (byte*) malloc(size);
+        /* zeroed slots of locked memory, never swapped or dumped */
+        pwdKey = wolfsslKeyAlloc(size);
+        iv = wolfsslKeyAlloc(block);
+        key = wolfsslKeyAlloc(size);
+        if (pwdKey == NULL || iv == NULL || key == NULL) {
+            wolfsslFreeKeys(pwdKey, iv, key);
+            return MEMORY_E;
+        }
 
         /* Start at the third flag entered */
         i = 3;
@@ -109,12 +120,93 @@ int wolfsslSetup(int argc, char** argv, char action)
 
             else if (XSTRNCMP(argv[i], "-pwd", 4) == 0 && argv[i+1] != NULL) {
                 /* password pwdKey */
-                XMEMCPY(pwdKey, argv[i+1], size);
+                pwdLen = XSTRLEN(argv[i+1]);
+                if (pwdLen > (size_t) size)
+                    pwdLen = size;
+                if (pwdLen > KEY_SLOT_SIZE - 1)
+                    pwdLen = KEY_SLOT_SIZE - 1;
+                XMEMSET(pwdKey, 0, KEY_SLOT_SIZE);
+                XMEMCPY(pwdKey, argv[i+1], pwdLen);
                 pwdKeyChk = 1;
                 keyType = 1;
                 i+=2;
                 continue;
             }
+            else if (XSTRNCMP(argv[i], "-chunk", 6) == 0 && argv[i+1] != NULL) {
+                /* bytes read, en/de crypted and written at a time */
+                if (wolfsslParseSize(argv[i+1], &chunkArg) != 0 ||
+                                    chunkArg < block || chunkArg > MAX_CHUNK) {
+                    printf("Invalid chunk size, must be between %d and %d. "
+                            "Using default of %d.\n", block, MAX_CHUNK,
+                            DEFAULT_CHUNK);
+                    chunkArg = DEFAULT_CHUNK;
+                }
+                i+=2;
+                continue;
+            }
+            else if (XSTRNCMP(argv[i], "-threads", 8) == 0 &&
+                                                        argv[i+1] != NULL) {
+                /* split seekable modes across worker threads */
+                io.threads = atoi(argv[i+1]);
+                if (io.threads < 1 || io.threads > MAX_THREADS) {
+                    printf("Invalid thread count, must be between 1-%d. "
+                            "Using 1.\n", MAX_THREADS);
+                    io.threads = 1;
+                }
+#ifndef HAVE_PTHREAD
+                printf("Built without thread support, using 1 thread.\n");
+                io.threads = 1;
+#endif
+                i+=2;
+                continue;
+            }
+            else if (XSTRNCMP(argv[i], "-kdf-iter", 9) == 0 &&
+                                                        argv[i+1] != NULL) {
+                /* PBKDF2 iterations, written to the file for decryption */
+                kdfIter = atoi(argv[i+1]);
+                if (kdfIter < KDF_MIN_ITERATIONS ||
+                                            kdfIter > KDF_MAX_ITERATIONS) {
+                    printf("Invalid iteration count, must be between %d and "
+                            "%d. Using %d.\n", KDF_MIN_ITERATIONS,
+                            KDF_MAX_ITERATIONS, KDF_ITERATIONS);
+                    kdfIter = KDF_ITERATIONS;
+                }
+                i+=2;
+                continue;
+            }
+            else if (XSTRNCMP(argv[i], "-kdf-target-ms", 14) == 0 &&
+                                                        argv[i+1] != NULL) {
+                /* pick the iterations that take this long here */
+                kdfTarget = atof(argv[i+1]);
+                if (kdfTarget <= 0 || kdfTarget > 60000) {
+                    printf("Invalid target, must be between 0 and 60000 "
+                            "milliseconds. Using %d iterations.\n",
+                            KDF_ITERATIONS);
+                    kdfTarget = 0;
+                }
+                i+=2;
+                continue;
+            }
+            else if (XSTRNCMP(argv[i], "-mmap", 5) == 0) {
+                /* map the files instead of reading them into buffers */
+                io.mmap = 1;
+                i++;
+                continue;
+            }
+            else if (XSTRNCMP(argv[i], "-io", 3) == 0 && argv[i+1] != NULL) {
+                /* overlap reads and writes with en/de cryption */
+                if (XSTRNCMP(argv[i+1], "uring", 5) == 0)
+                    io.backend = WOLFSSL_IO_URING;
+                else if (XSTRNCMP(argv[i+1], "thread", 6) == 0)
+                    io.backend = WOLFSSL_IO_THREAD;
+                else if (XSTRNCMP(argv[i+1], "sync", 4) == 0)
+                    io.backend = WOLFSSL_IO_SYNC;
+                else
+                    printf("Invalid io backend, must be uring, thread or "
+                            "sync. Using sync.\n");
+                i+=2;
+                continue;
+            }
             else if (XSTRNCMP(argv[i], "-verify", 7) == 0) {
                 /* using hexidecimal format */
                 inputHex = 1;
@@ -126,7 +218,7 @@ int wolfsslSetup(int argc, char** argv, char action)
                 if (pwdKeyChk == 1) {
                     printf("Invalid option, attempting to use IV with password"
                            " based key.");
-                    wolfsslFreeBins(pwdKey, iv, key, NULL, NULL);
+                    wolfsslFreeKeys(pwdKey, iv, key);
                     return FATAL_ERROR;
                 }
                  ivSize = block*2;
@@ -135,20 +227,16 @@ int wolfsslSetup(int argc, char** argv, char action)
                     printf("Invalid IV size was: %d.\n",
                                                        (int) strlen(argv[i+1]));
                     printf("size of IV expected was: %d.\n", ivSize);
-                    wolfsslFreeBins(pwdKey, iv, key, NULL, NULL);
+                    wolfsslFreeKeys(pwdKey, iv, key);
                     return FATAL_ERROR;
                 }
                 else {
-                    char ivString[XSTRLEN(argv[i+1])];
-                    XSTRNCPY(ivString, argv[i+1], XSTRLEN(argv[i+1]));
-                    ret = wolfsslHexToBin(ivString, &iv, &ivSize,
-                                            NULL, NULL, NULL,
-                                            NULL, NULL, NULL,
-                                            NULL, NULL, NULL);
+                    ivSize = block;
+                    ret = wolfsslHexToBuf(argv[i+1], iv, &ivSize);
                     if (ret != 0) {
                         printf("failed during conversion of IV, ret = %d\n",
                                                                            ret);
-                        wolfsslFreeBins(pwdKey, iv, key, NULL, NULL);
+                        wolfsslFreeKeys(pwdKey, iv, key);
                         return -1;
                     }
                     ivCheck = 1;
@@ -167,20 +255,16 @@ int wolfsslSetup(int argc, char** argv, char action)
                     printf("Length of key provided was: %d.\n", numBits);
                     printf("Length of key expected was: %d.\n", size);
                     printf("Invalid Key. Must match algorithm key size.\n");
-                    wolfsslFreeBins(pwdKey, iv, key, NULL, NULL);
+                    wolfsslFreeKeys(pwdKey, iv, key);
                     return FATAL_ERROR;
                 }
                 else {
-                    char keyString[strlen(argv[i+1])];
-                    XSTRNCPY(keyString, argv[i+1], XSTRLEN(argv[i+1]));
-                    ret = wolfsslHexToBin(keyString, &key, &numBits,
-                                            NULL, NULL, NULL,
-                                            NULL, NULL, NULL,
-                                            NULL, NULL, NULL);
+                    numBits = KEY_SLOT_SIZE;
+                    ret = wolfsslHexToBuf(argv[i+1], key, &numBits);
                      if (ret != 0) {
                         printf("failed during conversion of Key, ret = %d\n",
                                                                            ret);
-                        wolfsslFreeBins(pwdKey, iv, key, NULL, NULL);
+                        wolfsslFreeKeys(pwdKey, iv, key);
                         return -1;
                     }
                     keyCheck = 1;
@@ -193,7 +277,10 @@ int wolfsslSetup(int argc, char** argv, char action)
                 i++; continue;
             }
 
-        }while(i < 15);
+        }while(i < argc);
+
+        /* chunks are whole cipher blocks so only the last one is padded */
+        io.chunk = (int) (chunkArg - (chunkArg % block));
 
         if (pwdKeyChk == 0 && keyCheck == 0) {
             if (dCheck == 1) {
@@ -228,14 +315,14 @@ int wolfsslSetup(int argc, char** argv, char action)
         if (eCheck == 1 && dCheck == 1) {
             printf("You want to encrypt and decrypt simultaneously? That is"
                     "not possible...\n");
-            wolfsslFreeBins(pwdKey, iv, key, NULL, NULL);
+            wolfsslFreeKeys(pwdKey, iv, key);
             return FATAL_ERROR;
         }
 
         if (inCheck == 0 && dCheck == 1) {
             printf("We are so sorry but you must specify what it is you are "
                     "trying to decrypt.\n");
-            wolfsslFreeBins(pwdKey, iv, key, NULL, NULL);
+            wolfsslFreeKeys(pwdKey, iv, key);
             return FATAL_ERROR;
         }
 
@@ -244,7 +331,7 @@ int wolfsslSetup(int argc, char** argv, char action)
                 printf("-iv was explicitly set, but no -key was set. User\n"
                     " needs to provide a non-password based key when setting"
                         " the -iv flag.\n");
-                wolfsslFreeBins(pwdKey, iv, key, NULL, NULL);
+                wolfsslFreeKeys(pwdKey, iv, key);
                 return FATAL_ERROR;
             }
         }
@@ -265,11 +352,19 @@ int wolfsslSetup(int argc, char** argv, char action)
                     out = (ret > 0) ? outNameE : '\0';
                 }
             }
+            if (kdfTarget > 0 && ivCheck == 0) {
+                kdfIter = wolfsslKdfCalibrate(kdfTarget, size);
+                printf("Using %d PBKDF2 iterations, about %.0f ms here.\n",
+                                                        kdfIter, kdfTarget);
+            }
             ret = wolfsslEncrypt(alg, mode, pwdKey, key, size, in, out,
-                    iv, block, ivCheck, inputHex);
+                    iv, block, ivCheck, inputHex, kdfIter, &io);
         }
         /* decryption function call */
         else if (dCheck == 1) {
+            if (kdfIter != KDF_ITERATIONS || kdfTarget > 0)
+                printf("Ignoring -kdf-iter and -kdf-target-ms, the count is "
+                        "read from the encrypted file.\n");
             if (outCheck == 0) {
                 ret = 0;
                 while (ret == 0) {
@@ -279,16 +374,13 @@ int wolfsslSetup(int argc, char** argv, char action)
                 }
             }
             ret = wolfsslDecrypt(alg, mode, pwdKey, key, size, in, out,
-                    iv, block, keyType);
+                    iv, block, keyType, &io);
         }
         else {
             wolfsslHelp();
         }
-        /* clear and free data */
-        XMEMSET(key, 0, size);
-        XMEMSET(pwdKey, 0, size);
-        XMEMSET(iv, 0, block);
-        wolfsslFreeBins(pwdKey, iv, key, NULL, NULL);
+        /* wipe and free the slots */
+        wolfsslFreeKeys(pwdKey, iv, key);
     }
     else
         ret = FATAL_ERROR;
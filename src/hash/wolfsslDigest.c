@@ -0,0 +1,179 @@
+/* wolfsslDigest.c
+ *
+ * Copyright (C) 2006-2015 wolfSSL Inc.
+ *
+ * This file is part of wolfSSL. (formerly known as CyaSSL)
+ *
+ * wolfSSL is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfSSL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "include/wolfssl.h"
+
+/* update and final functions, one pair per algorithm */
+#ifndef NO_MD5
+static int wolfsslMd5Update(WolfsslDigest* digest, const byte* in, word32 sz)
+{
+    wc_Md5Update(&digest->ctx.md5, in, sz);
+    return 0;
+}
+
+static int wolfsslMd5Final(WolfsslDigest* digest, byte* out)
+{
+    wc_Md5Final(&digest->ctx.md5, out);
+    return 0;
+}
+#endif
+
+#ifndef NO_SHA
+static int wolfsslShaUpdate(WolfsslDigest* digest, const byte* in, word32 sz)
+{
+    return wc_ShaUpdate(&digest->ctx.sha, in, sz);
+}
+
+static int wolfsslShaFinal(WolfsslDigest* digest, byte* out)
+{
+    return wc_ShaFinal(&digest->ctx.sha, out);
+}
+#endif
+
+#ifndef NO_SHA256
+static int wolfsslSha256Update(WolfsslDigest* digest, const byte* in,
+                                                                    word32 sz)
+{
+    return wc_Sha256Update(&digest->ctx.sha256, in, sz);
+}
+
+static int wolfsslSha256Final(WolfsslDigest* digest, byte* out)
+{
+    return wc_Sha256Final(&digest->ctx.sha256, out);
+}
+#endif
+
+#ifdef WOLFSSL_SHA384
+static int wolfsslSha384Update(WolfsslDigest* digest, const byte* in,
+                                                                    word32 sz)
+{
+    return wc_Sha384Update(&digest->ctx.sha384, in, sz);
+}
+
+static int wolfsslSha384Final(WolfsslDigest* digest, byte* out)
+{
+    return wc_Sha384Final(&digest->ctx.sha384, out);
+}
+#endif
+
+#ifdef WOLFSSL_SHA512
+static int wolfsslSha512Update(WolfsslDigest* digest, const byte* in,
+                                                                    word32 sz)
+{
+    return wc_Sha512Update(&digest->ctx.sha512, in, sz);
+}
+
+static int wolfsslSha512Final(WolfsslDigest* digest, byte* out)
+{
+    return wc_Sha512Final(&digest->ctx.sha512, out);
+}
+#endif
+
+#ifdef HAVE_BLAKE2
+static int wolfsslBlake2bUpdate(WolfsslDigest* digest, const byte* in,
+                                                                    word32 sz)
+{
+    return wc_Blake2bUpdate(&digest->ctx.blake2b, in, sz);
+}
+
+static int wolfsslBlake2bFinal(WolfsslDigest* digest, byte* out)
+{
+    return wc_Blake2bFinal(&digest->ctx.blake2b, out, (word32) digest->size);
+}
+#endif
+
+/*
+ * starts a digest for alg and picks its update and final functions
+ */
+int wolfsslDigestInit(WolfsslDigest* digest, const char* alg, int size)
+{
+    int ret = FATAL_ERROR;          /* return variable */
+
+    XMEMSET(digest, 0, sizeof(WolfsslDigest));
+    digest->size = size;
+
+#ifndef NO_MD5
+    if (strcmp(alg, "md5") == 0) {
+        wc_InitMd5(&digest->ctx.md5);
+        digest->update = wolfsslMd5Update;
+        digest->final  = wolfsslMd5Final;
+        ret = 0;
+    }
+#endif
+#ifndef NO_SHA
+    if (strcmp(alg, "sha") == 0) {
+        ret = wc_InitSha(&digest->ctx.sha);
+        digest->update = wolfsslShaUpdate;
+        digest->final  = wolfsslShaFinal;
+    }
+#endif
+#ifndef NO_SHA256
+    if (strcmp(alg, "sha256") == 0) {
+        ret = wc_InitSha256(&digest->ctx.sha256);
+        digest->update = wolfsslSha256Update;
+        digest->final  = wolfsslSha256Final;
+    }
+#endif
+#ifdef WOLFSSL_SHA384
+    if (strcmp(alg, "sha384") == 0) {
+        ret = wc_InitSha384(&digest->ctx.sha384);
+        digest->update = wolfsslSha384Update;
+        digest->final  = wolfsslSha384Final;
+    }
+#endif
+#ifdef WOLFSSL_SHA512
+    if (strcmp(alg, "sha512") == 0) {
+        ret = wc_InitSha512(&digest->ctx.sha512);
+        digest->update = wolfsslSha512Update;
+        digest->final  = wolfsslSha512Final;
+    }
+#endif
+#ifdef HAVE_BLAKE2
+    if (strcmp(alg, "blake2b") == 0) {
+        ret = wc_InitBlake2b(&digest->ctx.blake2b, (word32) size);
+        digest->update = wolfsslBlake2bUpdate;
+        digest->final  = wolfsslBlake2bFinal;
+    }
+#endif
+
+    if (ret != 0 || digest->update == NULL) {
+        printf("Failed to start the %s digest.\n", alg);
+        wolfsslDigestFree(digest);
+        return ret != 0 ? ret : FATAL_ERROR;
+    }
+    return 0;
+}
+
+/*
+ * writes the digest to out, digest->size bytes
+ */
+int wolfsslDigestFinal(WolfsslDigest* digest, byte* out)
+{
+    return digest->final(digest, out);
+}
+
+/*
+ * clears the digest state
+ */
+void wolfsslDigestFree(WolfsslDigest* digest)
+{
+    XMEMSET(digest, 0, sizeof(WolfsslDigest));
+}
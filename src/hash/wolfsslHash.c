@@ -21,94 +21,243 @@
 
 #include "include/wolfssl.h"
 
-#define LENGTH_IN       (int)strlen(in)      /* type cast unsigned int to int */
+/*
+ * finishes the digest of one chunk, recording it or, when verifying,
+ * comparing it with the one the manifest expects
+ */
+static int wolfsslHashChunkDone(WolfsslDigest* part,
+                            WolfsslChunkDigests* chunks, int idx, int verify)
+{
+    byte got[MAX_DIGEST_SIZE];  /* digest of the chunk just read */
+    int  size = part->size;     /* digest size */
+    int  ret;                   /* return variable */
+
+    ret = wolfsslDigestFinal(part, got);
+    wolfsslDigestFree(part);
+    if (ret != 0)
+        return ret;
+
+    if (verify == 0)
+        XMEMCPY(chunks->digests + idx * size, got, size);
+    else if (XMEMCMP(chunks->digests + idx * size, got, size) != 0)
+        return DIGEST_MISMATCH;
+
+    return 0;
+}
 
 /*
- * hashing function
+ * hashes the whole input through the chunk sized buffer, or straight from
+ * the mapped pages with -mmap, so memory use doesn't grow with the file.
+ * Every one of the count digests is fed each piece while it is at hand, so
+ * the file is read once however many algorithms there are. With chunks,
+ * every chunks->chunk bytes also get a digest of their own.
  */
-int wolfsslHash(char* in, char* out, char* alg, int size)
+static int wolfsslHashStream(WolfsslDigest* digests, int count,
+                    WolfsslStream* stream, const char* alg,
+                    const WolfsslIo* io, byte* input,
+                    WolfsslChunkDigests* chunks, int verify)
 {
-#ifdef HAVE_BLAKE2
-    Blake2b hash;               /* blake2b declaration */
-#endif
-    FILE*   inFile;             /* input file */
-    FILE*   outFile;            /* output file */
+    WolfsslDigest part;         /* digest of the current chunk */
+    const byte* data;           /* the bytes to hash next */
+    int64_t pos     = 0;        /* bytes of the file hashed */
+    int64_t inChunk = 0;        /* bytes of the current chunk hashed */
+    int     idx     = 0;        /* current chunk */
+    int     n;                  /* bytes hashed this time */
+    int     i;                  /* loop variable */
+    int     ret     = 0;        /* return variable */
+    double  phase;              /* start of the phase being timed */
 
-    byte*   input;              /* input buffer */
-    byte*   output;             /* output buffer */
+    if (io->mmap == 1) {
+        ret = wolfsslStreamMap(stream, 'r');
+        if (ret != 0)
+            return ret;
+    }
 
-    int     i  =   0;           /* loop variable */
-    int     ret = -1;           /* return variable */
-    int     length;             /* length of hash */
+    while (ret == 0 && pos < stream->length) {
+        if (wolfsslPoolCancelled(NULL)) {
+            ret = POOL_CANCELLED;
+            break;
+        }
+        n = (stream->length - pos < io->chunk) ?
+                                    (int)(stream->length - pos) : io->chunk;
+        if (chunks != NULL && chunks->chunk - inChunk < n)
+            n = (int)(chunks->chunk - inChunk);
 
-    output = malloc(size);
-    XMEMSET(output, 0, size);
+        phase = wolfsslPhaseStart(io);
+        if (stream->map != NULL)
+            data = stream->map + pos;
+        else if (wolfsslStreamRead(stream, input, n) != n) {
+            ret = FREAD_ERROR;
+            break;
+        }
+        else
+            data = input;
+        wolfsslPhaseEnd(io, WOLFSSL_PHASE_READ, phase);
+
+        phase = wolfsslPhaseStart(io);
+        for (i = 0; ret == 0 && i < count; i++)
+            ret = wolfsslDigestUpdate(&digests[i], data, (word32) n);
+        wolfsslPhaseEnd(io, WOLFSSL_PHASE_CRYPTO, phase);
+        pos += n;
 
-    /* opens input file */
-    inFile = fopen(in, "rb");
-    if (inFile == NULL) {
-        /* if no input file was provided */
-        length = LENGTH_IN;
-
-        input = malloc(length);
-        XMEMSET(input, 0, length);
-        for (i = 0; i < length; i++) {
-            /* copies text from in to input */
-            if (i <= LENGTH_IN ) {
-                input[i] = in[i];
+        if (ret == 0 && chunks != NULL) {
+            if (inChunk == 0)
+                ret = wolfsslDigestInit(&part, alg, digests[0].size);
+            if (ret == 0)
+                ret = wolfsslDigestUpdate(&part, data, (word32) n);
+            inChunk += n;
+            /* a mismatching chunk fails the file without reading the rest */
+            if (ret == 0 && (inChunk == chunks->chunk ||
+                                                    pos == stream->length)) {
+                ret = wolfsslHashChunkDone(&part, chunks, idx++, verify);
+                inChunk = 0;
             }
         }
     }
-    else {
-        /* if input file provided finds end of file for length */
-        fseek(inFile, 0, SEEK_END);
-        int leng = (int) ftell(inFile);
-        fseek(inFile, 0, SEEK_SET);
+    if (inChunk > 0)
+        wolfsslDigestFree(&part);
+
+    wolfsslStreamUnmap(stream);
+
+    return ret;
+}
+
+/*
+ * hashes one file into output, optionally by chunk. input is a chunk sized
+ * buffer the caller keeps across files
+ */
+int wolfsslHashFileChunks(const char* name, const char* alg, int size,
+                    const WolfsslIo* io, byte* input, byte* output,
+                    WolfsslChunkDigests* chunks, int verify)
+{
+    WolfsslDigest digest;       /* running digest of the file */
+    WolfsslStream stream;       /* the file */
+    int64_t       count;        /* chunks in the file */
+    int           ret;          /* return variable */
 
-        length = leng;
+    if (wolfsslStreamOpen(&stream, name, 'r') != 0)
+        return FREAD_ERROR;
 
-        input = malloc(length+1);
-        XMEMSET(input, 0, length+1);
-        if (input == NULL) {
-            printf("Failed to create input buffer\n");
+    if (chunks != NULL) {
+        if (chunks->chunk <= 0) {
+            wolfsslStreamClose(&stream);
             return FATAL_ERROR;
         }
-        ret = (int) fread(input, 1, length, inFile);
-        fclose(inFile);
-    }
-    /* hashes using accepted algorithm */
-#ifndef NO_MD5
-    if (strcmp(alg, "md5") == 0) {
-        ret = wc_Md5Hash(input, length, output);
-    }
-#endif
-#ifndef NO_SHA
-    else if (strcmp(alg, "sha") == 0) {
-        ret = wc_ShaHash(input, length, output);
+        count = (stream.length + chunks->chunk - 1) / chunks->chunk;
+        if (verify == 1 && count != chunks->count) {
+            /* the file has the wrong length, no need to read it */
+            wolfsslStreamClose(&stream);
+            return DIGEST_MISMATCH;
+        }
+        if (verify == 0) {
+            chunks->count   = (int) count;
+            chunks->digests = (byte*) malloc(count > 0 ? count * size : 1);
+            if (chunks->digests == NULL) {
+                wolfsslStreamClose(&stream);
+                return MEMORY_E;
+            }
+        }
     }
-#endif
-#ifndef NO_SHA256
-    else if (strcmp(alg, "sha256") == 0) {
-        ret = wc_Sha256Hash(input, length, output);
+
+    ret = wolfsslDigestInit(&digest, alg, size);
+    if (ret == 0)
+        ret = wolfsslHashStream(&digest, 1, &stream, alg, io, input, chunks,
+                                                                        verify);
+    if (ret == 0)
+        ret = wolfsslDigestFinal(&digest, output);
+
+    wolfsslDigestFree(&digest);
+    wolfsslStreamClose(&stream);
+
+    return ret;
+}
+
+/*
+ * hashes one file into output, input is a chunk sized buffer the caller
+ * keeps across files
+ */
+int wolfsslHashFile(const char* name, const char* alg, int size,
+                                const WolfsslIo* io, byte* input, byte* output)
+{
+    return wolfsslHashFileChunks(name, alg, size, io, input, output, NULL, 0);
+}
+
+/*
+ * hashes one file with every algorithm in algs in a single read of it.
+ * output gets the digests one after the other, algs->total bytes
+ */
+int wolfsslHashFileAlgs(const char* name, const WolfsslHashAlgs* algs,
+                                const WolfsslIo* io, byte* input, byte* output)
+{
+    WolfsslDigest digests[MAX_HASH_ALGS];   /* one per algorithm */
+    WolfsslStream stream;       /* the file */
+    int           started = 0;  /* digests initialised */
+    int           off     = 0;  /* where the next digest goes in output */
+    int           i;            /* loop variable */
+    int           ret     = 0;  /* return variable */
+
+    if (algs->count == 1)
+        return wolfsslHashFile(name, algs->names[0], algs->sizes[0], io,
+                                                                input, output);
+
+    if (wolfsslStreamOpen(&stream, name, 'r') != 0)
+        return FREAD_ERROR;
+
+    for (; ret == 0 && started < algs->count; started++)
+        ret = wolfsslDigestInit(&digests[started], algs->names[started],
+                                                        algs->sizes[started]);
+    if (ret == 0)
+        ret = wolfsslHashStream(digests, algs->count, &stream, NULL, io,
+                                                            input, NULL, 0);
+    for (i = 0; ret == 0 && i < algs->count; i++) {
+        ret = wolfsslDigestFinal(&digests[i], output + off);
+        off += algs->sizes[i];
     }
-#endif
-#ifdef WOLFSSL_SHA384
-    else if (strcmp(alg, "sha384") == 0) {
-        ret = wc_Sha384Hash(input, length, output);
+
+    for (i = 0; i < started; i++)
+        wolfsslDigestFree(&digests[i]);
+    wolfsslStreamClose(&stream);
+
+    return ret;
+}
+
+/*
+ * hashing function
+ */
+int wolfsslHash(char* in, char* out, char* alg, int size, const WolfsslIo* io)
+{
+    WolfsslDigest digest;       /* digest of text input */
+    FILE*   outFile;            /* output file */
+    byte*   input;              /* input buffer */
+    byte*   output;             /* output buffer */
+
+    int     i  =   0;           /* loop variable */
+    int     ret;                /* return variable */
+
+    output = wolfsslBufAlloc(size);
+    input  = wolfsslBufAlloc(io->chunk);
+    if (output == NULL || input == NULL) {
+        printf("Failed to create input buffer\n");
+        wolfsslFreeBins(input, output, NULL, NULL, NULL);
+        return MEMORY_E;
     }
-#endif
-#ifdef WOLFSSL_SHA512
-    else if (strcmp(alg, "sha512") == 0) {
-        ret = wc_Sha512Hash(input, length, output);
+    XMEMSET(output, 0, size);
+
+    if (access(in, F_OK) == -1) {
+        /* if no input file was provided hash the text itself */
+        ret = wolfsslDigestInit(&digest, alg, size);
+        if (ret == 0)
+            ret = wolfsslDigestUpdate(&digest, (byte*)in, (word32) strlen(in));
+        if (ret == 0)
+            ret = wolfsslDigestFinal(&digest, output);
+        wolfsslDigestFree(&digest);
     }
-#endif
-#ifdef HAVE_BLAKE2
-    else if (strcmp(alg, "blake2b") == 0) {
-        ret = wc_InitBlake2b(&hash, size);
-        ret = wc_Blake2bUpdate(&hash, input, length);
-        ret = wc_Blake2bFinal(&hash, output, size);
+    else {
+        ret = wolfsslHashFile(in, alg, size, io, input, output);
+        if (ret != 0)
+            printf("Failed to hash input file\n");
     }
-#endif
+
     if (ret == 0) {
         /* if no errors so far */
         if (out != NULL) {
@@ -133,10 +282,7 @@ int wolfsslHash(char* in, char* out, char* alg, int size)
         }
     }
 
-    /* closes the opened files and frees the memory */
-    XMEMSET(input, 0, length);
-    XMEMSET(output, 0, size);
-    free(input);
-    free(output);
+    /* wipes and frees the memory */
+    wolfsslFreeBins(input, output, NULL, NULL, NULL);
     return ret;
 }
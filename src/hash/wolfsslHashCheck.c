@@ -0,0 +1,392 @@
+/* wolfsslHashCheck.c
+ *
+ * Copyright (C) 2006-2015 wolfSSL Inc.
+ *
+ * This file is part of wolfSSL. (formerly known as CyaSSL)
+ *
+ * wolfSSL is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfSSL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "include/wolfssl.h"
+
+/* the manifest, one entry per file to verify */
+typedef struct WolfsslCheckCtx {
+    WolfsslFileList      names;     /* file of every entry */
+    byte*                digests;   /* expected digest of every entry */
+    WolfsslChunkDigests* chunks;    /* expected chunk digests, if any */
+    int                  cap;       /* entries digests and chunks hold */
+    const char*          alg;       /* hash algorithm */
+    int                  size;      /* digest size */
+    const WolfsslIo*     io;        /* read size and mmap */
+    int                  quiet;     /* only print failures */
+    int                  passed;    /* files that matched */
+    int                  failed;    /* files that didn't */
+    int                  unread;    /* files that couldn't be read */
+} WolfsslCheckCtx;
+
+/*
+ * value of one hex character, either case, or -1
+ */
+static int wolfsslCheckNibble(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/*
+ * converts exactly 2*sz hex characters to sz bytes
+ */
+static int wolfsslCheckHex(const char* hex, int sz, byte* out)
+{
+    int i, hi, lo;              /* loop variable and nibbles */
+
+    for (i = 0; i < sz; i++) {
+        hi = wolfsslCheckNibble(hex[2*i]);
+        lo = (hi < 0) ? -1 : wolfsslCheckNibble(hex[2*i + 1]);
+        if (lo < 0)
+            return -1;
+        out[i] = (byte) ((hi << 4) | lo);
+    }
+
+    return 0;
+}
+
+/*
+ * undoes the escaping sha256sum gives names holding '\' or a newline
+ */
+static void wolfsslCheckUnescape(char* name)
+{
+    char* in  = name;           /* reads the escaped name */
+    char* out = name;           /* writes the plain name */
+
+    while (*in != '\0') {
+        if (in[0] == '\\' && in[1] == '\\') {
+            *out++ = '\\';
+            in += 2;
+        }
+        else if (in[0] == '\\' && in[1] == 'n') {
+            *out++ = '\n';
+            in += 2;
+        }
+        else
+            *out++ = *in++;
+    }
+    *out = '\0';
+}
+
+/*
+ * adds an entry to the manifest, taking over the chunk digests in pending
+ */
+static int wolfsslCheckAdd(WolfsslCheckCtx* ctx, const char* name,
+                            const byte* digest, WolfsslChunkDigests* pending)
+{
+    byte*                digests;
+    WolfsslChunkDigests* chunks;
+    int                  idx = ctx->names.count;
+    int                  cap;
+
+    if (idx == ctx->cap) {
+        cap     = (ctx->cap == 0) ? 16 : ctx->cap * 2;
+        digests = (byte*) realloc(ctx->digests, cap * ctx->size);
+        if (digests == NULL)
+            return MEMORY_E;
+        ctx->digests = digests;
+        chunks  = (WolfsslChunkDigests*) realloc(ctx->chunks,
+                                            cap * sizeof(WolfsslChunkDigests));
+        if (chunks == NULL)
+            return MEMORY_E;
+        ctx->chunks = chunks;
+        ctx->cap    = cap;
+    }
+
+    if (wolfsslFileListAdd(&ctx->names, name) != 0)
+        return MEMORY_E;
+    XMEMCPY(ctx->digests + idx * ctx->size, digest, ctx->size);
+    ctx->chunks[idx] = *pending;
+    XMEMSET(pending, 0, sizeof(WolfsslChunkDigests));
+
+    return 0;
+}
+
+/*
+ * reads a "#chunks <bytes per chunk> <digest> ..." line into pending
+ */
+static int wolfsslCheckChunks(WolfsslCheckCtx* ctx, char* line,
+                                                WolfsslChunkDigests* pending)
+{
+    char*   tok;                /* one field of the line */
+    char*   save = NULL;        /* strtok_r state */
+    int     count = 0;          /* digests on the line */
+    int     i;                  /* loop variable */
+
+    free(pending->digests);
+    XMEMSET(pending, 0, sizeof(WolfsslChunkDigests));
+
+    for (i = 0; line[i] != '\0'; i++) {
+        if (line[i] == ' ')
+            count++;
+    }
+    count--;                    /* the first space comes before the size */
+
+    tok = strtok_r(line + 8, " ", &save);
+    if (tok == NULL || count < 0 || (pending->chunk = atoi(tok)) <= 0)
+        return FATAL_ERROR;
+
+    pending->digests = (byte*) malloc(count > 0 ? count * ctx->size : 1);
+    if (pending->digests == NULL)
+        return MEMORY_E;
+
+    while ((tok = strtok_r(NULL, " ", &save)) != NULL) {
+        if (pending->count == count || (int) strlen(tok) != 2 * ctx->size ||
+                        wolfsslCheckHex(tok, ctx->size,
+                        pending->digests + pending->count * ctx->size) != 0) {
+            free(pending->digests);
+            XMEMSET(pending, 0, sizeof(WolfsslChunkDigests));
+            return FATAL_ERROR;
+        }
+        pending->count++;
+    }
+
+    return 0;
+}
+
+/*
+ * reads one manifest line. Accepts "digest  name" and "digest *name" as
+ * sha256sum writes them, "SHA256 (name) = digest" as sha256sum --tag does,
+ * and a bare digest, optionally followed by " ^" like tests/byte-hashes.sha1,
+ * which takes the next of the files given with -in.
+ */
+static int wolfsslCheckLine(WolfsslCheckCtx* ctx, char* line,
+            WolfsslFileList* files, int* bare, WolfsslChunkDigests* pending)
+{
+    byte        digest[MAX_DIGEST_SIZE];
+    char        tagBuf[32];     /* room for a BLAKE2b-NNN tag */
+    const char* tag;            /* this algorithm's BSD style name */
+    char*       name;           /* file the line is about */
+    char*       end;            /* last ") = " of a BSD style line */
+    int         escaped = 0;    /* name is escaped */
+    int         hexLen  = 2 * ctx->size;
+    int         len;
+
+    if (line[0] == '\\') {
+        escaped = 1;
+        line++;
+    }
+    len = (int) strlen(line);
+    tag = wolfsslHashTagName(ctx->alg, ctx->size, tagBuf, sizeof(tagBuf));
+
+    if (strncmp(line, tag, strlen(tag)) == 0 &&
+                                    strncmp(line + strlen(tag), " (", 2) == 0) {
+        /* SHA256 (name) = digest */
+        name = line + strlen(tag) + 2;
+        end  = NULL;
+        for (len = (int) strlen(name) - 4; len >= 0; len--) {
+            if (strncmp(name + len, ") = ", 4) == 0) {
+                end = name + len;
+                break;
+            }
+        }
+        if (end == NULL || (int) strlen(end + 4) != hexLen ||
+                                wolfsslCheckHex(end + 4, ctx->size, digest) != 0)
+            return FATAL_ERROR;
+        *end = '\0';
+    }
+    else if (len > hexLen + 2 && line[hexLen] == ' ' &&
+                        (line[hexLen + 1] == ' ' || line[hexLen + 1] == '*')) {
+        /* digest  name */
+        if (wolfsslCheckHex(line, ctx->size, digest) != 0)
+            return FATAL_ERROR;
+        name = line + hexLen + 2;
+    }
+    else if (len >= hexLen && escaped == 0 &&
+                                wolfsslCheckHex(line, ctx->size, digest) == 0) {
+        /* digest on its own, anything after it must be blanks or '^' */
+        for (end = line + hexLen; *end == ' ' || *end == '\t' || *end == '^';)
+            end++;
+        if (*end != '\0')
+            return FATAL_ERROR;
+        if (*bare >= files->count) {
+            printf("No -in file left for digest %.*s\n", hexLen, line);
+            return FATAL_ERROR;
+        }
+        name = files->names[(*bare)++];
+    }
+    else
+        return FATAL_ERROR;
+
+    if (escaped)
+        wolfsslCheckUnescape(name);
+
+    return wolfsslCheckAdd(ctx, name, digest, pending);
+}
+
+/*
+ * reads every line of the manifest into ctx
+ */
+static int wolfsslCheckRead(WolfsslCheckCtx* ctx, const char* manifest,
+                                            WolfsslFileList* files, int* bad)
+{
+    WolfsslChunkDigests pending;    /* "#chunks" line for the next entry */
+    FILE*   in;                     /* the manifest */
+    char*   line   = NULL;          /* one line, grown by getline */
+    size_t  lineSz = 0;             /* allocated size of line */
+    ssize_t got;                    /* length of the line */
+    int     bare   = 0;             /* -in files taken by bare digests */
+    int     lineNo = 0;             /* for messages */
+    int     ret    = 0;             /* return variable */
+
+    XMEMSET(&pending, 0, sizeof(pending));
+
+    in = (strcmp(manifest, "-") == 0) ? stdin : fopen(manifest, "rb");
+    if (in == NULL) {
+        printf("Failed to open manifest %s\n", manifest);
+        return FREAD_ERROR;
+    }
+
+    while (ret != MEMORY_E && (got = getline(&line, &lineSz, in)) > 0) {
+        lineNo++;
+        while (got > 0 && (line[got - 1] == '\n' || line[got - 1] == '\r'))
+            line[--got] = '\0';
+        if (got == 0)
+            continue;
+
+        if (strncmp(line, "#chunks ", 8) == 0)
+            ret = wolfsslCheckChunks(ctx, line, &pending);
+        else if (line[0] == '#')
+            continue;
+        else
+            ret = wolfsslCheckLine(ctx, line, files, &bare, &pending);
+
+        if (ret == FATAL_ERROR) {
+            fprintf(stderr, "wolfssl: %s: %d: improperly formatted line\n",
+                                                            manifest, lineNo);
+            (*bad)++;
+        }
+    }
+
+    free(pending.digests);
+    free(line);
+    if (in != stdin)
+        fclose(in);
+
+    return ret == MEMORY_E ? MEMORY_E : 0;
+}
+
+/*
+ * verifies entry idx, a wolfsslHashRun job
+ */
+static int wolfsslCheckJob(void* arg, int idx, byte* input)
+{
+    WolfsslCheckCtx*     ctx    = (WolfsslCheckCtx*) arg;
+    WolfsslChunkDigests* chunks = &ctx->chunks[idx];
+    byte                 got[MAX_DIGEST_SIZE];
+    int                  ret;
+
+    if (chunks->chunk > 0)
+        ret = wolfsslHashFileChunks(ctx->names.names[idx], ctx->alg,
+                            ctx->size, ctx->io, input, got, chunks, 1);
+    else
+        ret = wolfsslHashFile(ctx->names.names[idx], ctx->alg, ctx->size,
+                                                        ctx->io, input, got);
+
+    if (ret == 0 && XMEMCMP(got, ctx->digests + idx * ctx->size,
+                                                            ctx->size) != 0)
+        ret = DIGEST_MISMATCH;
+
+    return ret;
+}
+
+/*
+ * reports entry idx, a wolfsslHashRun done function
+ */
+static void wolfsslCheckDone(void* arg, int idx, int ret, int err)
+{
+    WolfsslCheckCtx* ctx  = (WolfsslCheckCtx*) arg;
+    const char*      name = ctx->names.names[idx];
+
+    if (ret == 0) {
+        ctx->passed++;
+        if (ctx->quiet == 0)
+            printf("%s: OK\n", name);
+    }
+    else if (ret == DIGEST_MISMATCH) {
+        ctx->failed++;
+        printf("%s: FAILED\n", name);
+    }
+    else {
+        ctx->unread++;
+        fprintf(stderr, "wolfssl: %s: %s\n", name,
+                                err != 0 ? strerror(err) : "hashing failed");
+        printf("%s: FAILED open or read\n", name);
+    }
+}
+
+/*
+ * verifies every file in a manifest on a pool of worker threads
+ */
+int wolfsslHashCheck(const char* manifest, WolfsslFileList* files, char* alg,
+                                    int size, const WolfsslIo* io, int quiet)
+{
+    WolfsslCheckCtx ctx;            /* manifest and tallies */
+    int64_t* sizes;                 /* of each file, biggest start first */
+    int     bad = 0;                /* improperly formatted lines */
+    int     ret;                    /* return variable */
+    int     i;                      /* loop variable */
+
+    if (size > MAX_DIGEST_SIZE)
+        return FATAL_ERROR;
+
+    XMEMSET(&ctx, 0, sizeof(ctx));
+    ctx.alg   = alg;
+    ctx.size  = size;
+    ctx.io    = io;
+    ctx.quiet = quiet;
+
+    ret = wolfsslCheckRead(&ctx, manifest, files, &bad);
+    if (ret == 0) {
+        sizes = wolfsslFileListSizes(&ctx.names);
+        ret = wolfsslHashRun(ctx.names.count, io->threads, io->chunk, sizes,
+                                    wolfsslCheckJob, wolfsslCheckDone, &ctx);
+        free(sizes);
+    }
+
+    if (ret == 0) {
+        printf("%d files checked: %d passed, %d failed, %d unreadable",
+                ctx.names.count, ctx.passed, ctx.failed, ctx.unread);
+        if (bad > 0)
+            printf(", %d improperly formatted lines", bad);
+        printf("\n");
+
+        if (ctx.failed > 0)
+            ret = DIGEST_MISMATCH;
+        else if (ctx.unread > 0)
+            ret = FREAD_ERROR;
+        else if (bad > 0 || ctx.names.count == 0)
+            ret = FATAL_ERROR;
+    }
+
+    for (i = 0; i < ctx.names.count; i++)
+        free(ctx.chunks[i].digests);
+    free(ctx.chunks);
+    free(ctx.digests);
+    wolfsslFileListFree(&ctx.names);
+
+    return ret;
+}
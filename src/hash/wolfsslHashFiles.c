@@ -0,0 +1,365 @@
+/* wolfsslHashFiles.c
+ *
+ * Copyright (C) 2006-2015 wolfSSL Inc.
+ *
+ * This file is part of wolfSSL. (formerly known as CyaSSL)
+ *
+ * wolfSSL is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfSSL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "include/wolfssl.h"
+
+/* what every job of a wolfsslHashRun shares */
+typedef struct WolfsslHashShared {
+    WolfsslHashJobFunc job;     /* runs one job */
+    void*              ctx;     /* passed to job and done */
+    int                chunk;   /* size of each worker's read buffer */
+    byte*              inputs[MAX_THREADS]; /* read buffer of each worker,
+                                             * made by its first job */
+} WolfsslHashShared;
+
+/* one job of a wolfsslHashRun, its pool task and its outcome */
+typedef struct WolfsslHashJob {
+    WolfsslTask        task;    /* future of the job */
+    WolfsslHashShared* shared;  /* what every job shares */
+    int                idx;     /* job number */
+    int                err;     /* errno after the job */
+} WolfsslHashJob;
+
+/* where a job goes in the order jobs start */
+typedef struct WolfsslHashOrder {
+    int64_t            size;    /* bytes the job reads */
+    int                idx;     /* job number */
+} WolfsslHashOrder;
+
+/* what wolfsslHashFiles' jobs need */
+typedef struct WolfsslHashFilesCtx {
+    WolfsslFileList*     files; /* files to hash, in output order */
+    const WolfsslHashAlgs* algs;    /* hash algorithms and digest sizes */
+    const WolfsslIo*     io;    /* read size and mmap */
+    byte*                digests;   /* algs->total bytes per file */
+    WolfsslChunkDigests* chunks;    /* per file, NULL without -chunks */
+    FILE*                out;   /* where the lines go */
+    int                  tag;   /* BSD style lines */
+    int                  ret;   /* FREAD_ERROR once a file fails */
+} WolfsslHashFilesCtx;
+
+/*
+ * name of alg as sha256sum --tag and its siblings print it
+ */
+const char* wolfsslHashTagName(const char* alg, int size, char* buf, int sz)
+{
+    if (strcmp(alg, "md5") == 0)
+        return "MD5";
+    if (strcmp(alg, "sha") == 0)
+        return "SHA1";
+    if (strcmp(alg, "sha256") == 0)
+        return "SHA256";
+    if (strcmp(alg, "sha384") == 0)
+        return "SHA384";
+    if (strcmp(alg, "sha512") == 0)
+        return "SHA512";
+    if (strcmp(alg, "blake2b") == 0 && size != BLAKE_DIGEST_SIZE) {
+        /* b2sum names shorter digests by their length in bits */
+        snprintf(buf, sz, "BLAKE2b-%d", size * 8);
+        return buf;
+    }
+    if (strcmp(alg, "blake2b") == 0)
+        return "BLAKE2b";
+    return alg;
+}
+
+/*
+ * prints one line of output, "digest  name" like sha256sum or with tag
+ * "SHA256 (name) = digest" like sha256sum --tag
+ */
+void wolfsslHashPrint(FILE* out, const char* alg, const byte* digest,
+                                        int size, const char* name, int tag)
+{
+    char        tagBuf[32];     /* room for a BLAKE2b-NNN tag */
+    const char* c;              /* walks the name */
+    int         i;              /* loop variable */
+    int         escape = 0;     /* name needs coreutils escaping */
+
+    for (c = name; *c != '\0'; c++) {
+        if (*c == '\\' || *c == '\n')
+            escape = 1;
+    }
+
+    if (tag == 1)
+        fprintf(out, "%s%s (", escape ? "\\" : "",
+                    wolfsslHashTagName(alg, size, tagBuf, sizeof(tagBuf)));
+    else if (escape)
+        fputc('\\', out);
+
+    if (tag == 0) {
+        for (i = 0; i < size; i++)
+            fprintf(out, "%02x", digest[i]);
+        fputs("  ", out);
+    }
+
+    for (c = name; *c != '\0'; c++) {
+        if (escape && *c == '\\')
+            fputs("\\\\", out);
+        else if (escape && *c == '\n')
+            fputs("\\n", out);
+        else
+            fputc(*c, out);
+    }
+
+    if (tag == 1) {
+        fputs(") = ", out);
+        for (i = 0; i < size; i++)
+            fprintf(out, "%02x", digest[i]);
+    }
+    fputc('\n', out);
+}
+
+/*
+ * prints the chunk digests of a file on a line of their own ahead of its
+ * digest line, "#chunks <bytes per chunk> <digest> <digest> ..."
+ */
+void wolfsslHashPrintChunks(FILE* out, const WolfsslChunkDigests* chunks,
+                                                                    int size)
+{
+    int i, j;                   /* loop variables */
+
+    fprintf(out, "#chunks %d", chunks->chunk);
+    for (i = 0; i < chunks->count; i++) {
+        fputc(' ', out);
+        for (j = 0; j < size; j++)
+            fprintf(out, "%02x", chunks->digests[i * size + j]);
+    }
+    fputc('\n', out);
+}
+
+/*
+ * runs one job with the read buffer of the worker it landed on, a pool task
+ */
+static int wolfsslHashTask(void* arg, int worker)
+{
+    WolfsslHashJob*    job    = (WolfsslHashJob*) arg;
+    WolfsslHashShared* shared = job->shared;
+    int                ret;     /* return variable */
+
+    if (shared->inputs[worker] == NULL)
+        shared->inputs[worker] = wolfsslBufAlloc(shared->chunk);
+    if (shared->inputs[worker] == NULL)
+        return MEMORY_E;
+
+    errno = 0;
+    ret = shared->job(shared->ctx, job->idx, shared->inputs[worker]);
+    job->err = errno;
+
+    return ret;
+}
+
+/*
+ * qsort order of WolfsslHashOrder, biggest first and ties in job order
+ */
+static int wolfsslHashBigger(const void* a, const void* b)
+{
+    const WolfsslHashOrder* x = (const WolfsslHashOrder*) a;
+    const WolfsslHashOrder* y = (const WolfsslHashOrder*) b;
+
+    if (x->size != y->size)
+        return (x->size < y->size) - (x->size > y->size);
+    return x->idx - y->idx;
+}
+
+/*
+ * runs count jobs on a pool of up to threads workers, the biggest first so
+ * a large file late in the list doesn't run on alone once the rest are
+ * done. done is called on this thread for every job in order, as soon as it
+ * and every job before it finished. Stops reporting at the first cancelled
+ * job.
+ */
+int wolfsslHashRun(int count, int threads, int chunk, const int64_t* sizes,
+        WolfsslHashJobFunc job, WolfsslHashDoneFunc done, void* ctx)
+{
+    WolfsslPool        pool;        /* workers */
+    WolfsslHashShared  shared;      /* what the jobs share */
+    WolfsslHashJob*    jobs;        /* one per job */
+    WolfsslHashOrder*  order;       /* the order jobs start in */
+    int     reported = 0;           /* jobs handed to done */
+    int     ret      = 0;           /* return variable */
+    int     i;                      /* loop variable */
+
+    XMEMSET(&shared, 0, sizeof(shared));
+    shared.job   = job;
+    shared.ctx   = ctx;
+    shared.chunk = chunk;
+    jobs  = (WolfsslHashJob*) calloc(count > 0 ? count : 1,
+                                                    sizeof(WolfsslHashJob));
+    order = (WolfsslHashOrder*) calloc(count > 0 ? count : 1,
+                                                    sizeof(WolfsslHashOrder));
+    if (jobs == NULL || order == NULL) {
+        free(jobs);
+        free(order);
+        return MEMORY_E;
+    }
+
+    for (i = 0; i < count; i++) {
+        jobs[i].shared = &shared;
+        jobs[i].idx    = i;
+        order[i].size  = (sizes != NULL) ? sizes[i] : 0;
+        order[i].idx   = i;
+    }
+    if (sizes != NULL)
+        qsort(order, count, sizeof(WolfsslHashOrder), wolfsslHashBigger);
+
+    if (threads > count)
+        threads = count;
+    /* a couple of jobs queued per worker keeps them all busy */
+    wolfsslPoolInit(&pool, threads, 2 * threads);
+
+    for (i = 0; i < count; i++) {
+        wolfsslPoolSubmit(&pool, &jobs[order[i].idx].task, wolfsslHashTask,
+                                                NULL, &jobs[order[i].idx]);
+        /* report what finished while the queue was full */
+        while (ret == 0 && reported < count &&
+                            wolfsslPoolPoll(&pool, &jobs[reported].task)) {
+            ret = (jobs[reported].task.ret == POOL_CANCELLED) ?
+                                                        POOL_CANCELLED : 0;
+            if (ret == 0)
+                done(ctx, reported, jobs[reported].task.ret,
+                                                        jobs[reported].err);
+            reported++;
+        }
+    }
+    for (; reported < count; reported++) {
+        if (wolfsslPoolWait(&pool, &jobs[reported].task) == POOL_CANCELLED)
+            ret = POOL_CANCELLED;
+        if (ret == 0)
+            done(ctx, reported, jobs[reported].task.ret, jobs[reported].err);
+    }
+
+    wolfsslPoolFree(&pool);
+    for (i = 0; i < MAX_THREADS; i++)
+        wolfsslBufFree(shared.inputs[i]);
+    free(jobs);
+    free(order);
+
+    return ret;
+}
+
+/*
+ * hashes file idx of the list, a wolfsslHashRun job
+ */
+static int wolfsslHashFilesJob(void* arg, int idx, byte* input)
+{
+    WolfsslHashFilesCtx* ctx = (WolfsslHashFilesCtx*) arg;
+    byte* digest = ctx->digests + idx * ctx->algs->total;
+
+    if (ctx->chunks != NULL) {
+        ctx->chunks[idx].chunk = ctx->io->chunk;
+        return wolfsslHashFileChunks(ctx->files->names[idx],
+                        ctx->algs->names[0], ctx->algs->sizes[0], ctx->io,
+                        input, digest, &ctx->chunks[idx], 0);
+    }
+    return wolfsslHashFileAlgs(ctx->files->names[idx], ctx->algs, ctx->io,
+                                                                input, digest);
+}
+
+/*
+ * prints the line for file idx, a wolfsslHashRun done function
+ */
+static void wolfsslHashFilesDone(void* arg, int idx, int ret, int err)
+{
+    WolfsslHashFilesCtx* ctx = (WolfsslHashFilesCtx*) arg;
+    byte* digest = ctx->digests + idx * ctx->algs->total;
+    int   i;                    /* loop variable */
+
+    if (ret == 0) {
+        if (ctx->chunks != NULL)
+            wolfsslHashPrintChunks(ctx->out, &ctx->chunks[idx],
+                                                        ctx->algs->sizes[0]);
+        for (i = 0; i < ctx->algs->count; i++) {
+            wolfsslHashPrint(ctx->out, ctx->algs->names[i], digest,
+                    ctx->algs->sizes[i], ctx->files->names[idx], ctx->tag);
+            digest += ctx->algs->sizes[i];
+        }
+    }
+    else {
+        fprintf(stderr, "wolfssl: %s: %s\n", ctx->files->names[idx],
+                                err != 0 ? strerror(err) : "hashing failed");
+        ctx->ret = FREAD_ERROR;
+    }
+
+    if (ctx->chunks != NULL) {
+        free(ctx->chunks[idx].digests);
+        ctx->chunks[idx].digests = NULL;
+    }
+}
+
+/*
+ * hashes every file in the list on a pool of worker threads, printing a
+ * line per file and algorithm in list order
+ */
+int wolfsslHashFiles(WolfsslFileList* files, char* out,
+                const WolfsslHashAlgs* algs, const WolfsslIo* io, int tag,
+                int chunks)
+{
+    WolfsslHashFilesCtx ctx;        /* shared with the jobs */
+    int64_t* sizes;                 /* of each file, biggest start first */
+    int     ret;                    /* return variable */
+    int     count = files->count > 0 ? files->count : 1;
+
+    if (algs->count < 1 || algs->count > MAX_HASH_ALGS ||
+                                        (chunks == 1 && algs->count != 1))
+        return FATAL_ERROR;
+
+    XMEMSET(&ctx, 0, sizeof(ctx));
+    ctx.files   = files;
+    ctx.algs    = algs;
+    ctx.io      = io;
+    ctx.tag     = tag;
+    ctx.out     = stdout;
+    ctx.digests = (byte*) calloc(count, algs->total);
+    if (chunks == 1)
+        ctx.chunks = (WolfsslChunkDigests*) calloc(count,
+                                                sizeof(WolfsslChunkDigests));
+    if (ctx.digests == NULL || (chunks == 1 && ctx.chunks == NULL)) {
+        free(ctx.digests);
+        free(ctx.chunks);
+        return MEMORY_E;
+    }
+
+    if (out != NULL) {
+        ctx.out = fopen(out, "wb");
+        if (ctx.out == NULL) {
+            printf("Failed to open output file %s\n", out);
+            free(ctx.digests);
+            free(ctx.chunks);
+            return FWRITE_ERROR;
+        }
+    }
+
+    sizes = wolfsslFileListSizes(files);
+    ret = wolfsslHashRun(files->count, io->threads, io->chunk, sizes,
+                            wolfsslHashFilesJob, wolfsslHashFilesDone, &ctx);
+    free(sizes);
+    if (ret == 0)
+        ret = ctx.ret;
+
+    if (ctx.out != stdout)
+        fclose(ctx.out);
+    else
+        fflush(stdout);
+    free(ctx.digests);
+    free(ctx.chunks);
+
+    return ret;
+}
@@ -21,6 +21,34 @@
 
 #include "include/wolfssl.h"
 
+/*
+ * digest size of alg, blake2b takes whatever -size asked for
+ */
+static int wolfsslHashSize(const char* alg, int blakeSize)
+{
+#ifndef NO_MD5
+    if (strcmp(alg, "md5") == 0)
+        return MD5_DIGEST_SIZE;
+#endif
+#ifndef NO_SHA
+    if (strcmp(alg, "sha") == 0)
+        return SHA_DIGEST_SIZE;
+#endif
+#ifndef NO_SHA256
+    if (strcmp(alg, "sha256") == 0)
+        return SHA256_DIGEST_SIZE;
+#endif
+#ifdef WOLFSSL_SHA384
+    if (strcmp(alg, "sha384") == 0)
+        return SHA384_DIGEST_SIZE;
+#endif
+#ifdef WOLFSSL_SHA512
+    if (strcmp(alg, "sha512") == 0)
+        return SHA512_DIGEST_SIZE;
+#endif
+    return blakeSize;
+}
+
 /*
  * hash argument function
  */
@@ -28,7 +56,7 @@ int wolfsslHashSetup(int argc, char** argv)
 {
     int     ret        =   0;   /* return variable, counter */
     int     i          =   0;   /* loop variable */
-    char*   in;                 /* input variable */
+    char*   in = NULL;          /* input variable */
     char*   out     =   NULL;   /* output variable */
     const char* algs[]  =   {   /* list of acceptable algorithms */
 #ifndef NO_MD5
@@ -52,9 +80,25 @@ int wolfsslHashSetup(int argc, char** argv)
     };
 
     char*   alg;                /* algorithm being used */
+    char    algBuf[64];         /* argv[2] split at its commas */
+    WolfsslHashAlgs hashAlgs;   /* every algorithm named in argv[2] */
     int     algCheck=   0;      /* acceptable algorithm check */
     int     inCheck =   0;      /* input check */
     int     size    =   0;      /* message digest size */
+    /* how to read */
+    WolfsslIo io = {DEFAULT_CHUNK, 0, 0, WOLFSSL_IO_SYNC, NULL};
+    WolfsslFileList files;      /* every input file to hash */
+    char*   list    =   NULL;   /* -inlist file of names */
+    int     delim   =   '\n';   /* what separates names in list */
+    int     tag     =   0;      /* BSD style output lines */
+    int     added;              /* names taken after this -in */
+    char*   check   =   NULL;   /* -check manifest to verify */
+    int     chunks  =   0;      /* print per chunk digests too */
+    int     quiet   =   0;      /* -check only prints failures */
+    int64_t chunkArg;           /* -chunk as given by the user */
+    long    cpus;               /* online processors */
+
+    XMEMSET(&files, 0, sizeof(files));
 
 #ifdef HAVE_BLAKE2
     size = BLAKE_DIGEST_SIZE;
@@ -72,27 +116,97 @@ int wolfsslHashSetup(int argc, char** argv)
         }
     }
 
-    for (i = 0; i < (int) sizeof(algs)/(int) sizeof(algs[0]); i++) {
-        /* checks for acceptable algorithms */
-        if (strcmp(argv[2], algs[i]) == 0) {
-            alg = argv[2];
-            algCheck = 1;
+    /* md5,sha256 asks for several digests from one read of each file */
+    XMEMSET(&hashAlgs, 0, sizeof(hashAlgs));
+    if (strlen(argv[2]) >= sizeof(algBuf)) {
+        printf("Invalid algorithm\n");
+        return FATAL_ERROR;
+    }
+    XSTRNCPY(algBuf, argv[2], sizeof(algBuf));
+    alg = strtok(algBuf, ",");
+    while (alg != NULL) {
+        algCheck = 0;
+        for (i = 0; i < (int) sizeof(algs)/(int) sizeof(algs[0]); i++) {
+            /* checks for acceptable algorithms */
+            if (strcmp(alg, algs[i]) == 0)
+                algCheck = 1;
+        }
+        if (algCheck == 0 || hashAlgs.count == MAX_HASH_ALGS) {
+            printf("Invalid algorithm %s\n", alg);
+            return FATAL_ERROR;
         }
+        hashAlgs.names[hashAlgs.count++] = alg;
+        alg = strtok(NULL, ",");
     }
-    if (algCheck == 0) {
+    if (hashAlgs.count == 0) {
         printf("Invalid algorithm\n");
         return FATAL_ERROR;
     }
+    alg = hashAlgs.names[0];
 
     for (i = 3; i < argc; i++) {
-        if (XSTRNCMP(argv[i], "-in", 3) == 0 && argv[i+1] != NULL) {
-            /* input file/text */
-            in = malloc(strlen(argv[i+1])+1);
-            XSTRNCPY(in, &argv[i+1][0], XSTRLEN(&argv[i+1][0]));
-            in[XSTRLEN(argv[i+1])] = '\0';
+        if (XSTRNCMP(argv[i], "-inlist", 7) == 0 && argv[i+1] != NULL) {
+            /* file holding the names of the files to hash, - for stdin */
+            list = argv[i+1];
             inCheck = 1;
             i++;
         }
+        else if (XSTRNCMP(argv[i], "-in", 3) == 0 && argv[i+1] != NULL) {
+            /* input file/text, any number of files may follow */
+            added = 0;
+            while (i + 1 < argc && (argv[i+1][0] != '-' || added == 0)) {
+                if (wolfsslFileListAdd(&files, argv[i+1]) != 0) {
+                    wolfsslFileListFree(&files);
+                    return MEMORY_E;
+                }
+                inCheck = 1;
+                added++;
+                i++;
+            }
+        }
+        else if (XSTRNCMP(argv[i], "-check", 6) == 0 && argv[i+1] != NULL) {
+            /* manifest of digests to verify files against, - for stdin */
+            check = argv[i+1];
+            inCheck = 1;
+            i++;
+        }
+        else if (XSTRNCMP(argv[i], "-chunks", 7) == 0) {
+            /* digests per chunk so -check can fail a file early */
+            chunks = 1;
+        }
+        else if (XSTRNCMP(argv[i], "-chunk", 6) == 0 && argv[i+1] != NULL) {
+            /* bytes read at a time, and covered by each -chunks digest */
+            if (wolfsslParseSize(argv[i+1], &chunkArg) != 0 ||
+                                        chunkArg < 1 || chunkArg > MAX_CHUNK) {
+                printf("Invalid chunk size, must be between 1 and %d. "
+                        "Using default of %d.\n", MAX_CHUNK, DEFAULT_CHUNK);
+                chunkArg = DEFAULT_CHUNK;
+            }
+            io.chunk = (int) chunkArg;
+            i++;
+        }
+        else if (XSTRNCMP(argv[i], "-quiet", 6) == 0) {
+            /* -check prints failures and the summary only */
+            quiet = 1;
+        }
+        else if (XSTRNCMP(argv[i], "-null", 5) == 0) {
+            /* names in -inlist are NUL separated, as find -print0 writes */
+            delim = '\0';
+        }
+        else if (XSTRNCMP(argv[i], "-tag", 4) == 0) {
+            /* SHA256 (name) = digest */
+            tag = 1;
+        }
+        else if (XSTRNCMP(argv[i], "-threads", 8) == 0 && argv[i+1] != NULL) {
+            /* workers hashing files side by side */
+            io.threads = atoi(argv[i+1]);
+            if (io.threads < 1 || io.threads > MAX_THREADS) {
+                printf("Invalid thread count, must be between 1-%d. "
+                        "Using default.\n", MAX_THREADS);
+                io.threads = 0;
+            }
+            i++;
+        }
         else if (XSTRNCMP(argv[i], "-out", 4) == 0 && argv[i+1] != NULL) {
             /* output file */
             out = argv[i+1];
@@ -111,6 +225,10 @@ int wolfsslHashSetup(int argc, char** argv)
 #endif
             i++;
         }
+        else if (XSTRNCMP(argv[i], "-mmap", 5) == 0) {
+            /* hash the input from mapped pages */
+            io.mmap = 1;
+        }
         else {
             printf("Unknown argument %s. Ignoring\n", argv[i]);
         }
@@ -119,36 +237,56 @@ int wolfsslHashSetup(int argc, char** argv)
         printf("Must have input as either a file or standard I/O\n");
         return FATAL_ERROR;
     }
-    /* sets default size of algorithm */
-#ifndef NO_MD5
-    if (XSTRNCMP(alg, "md5", 3) == 0)
-        size = MD5_DIGEST_SIZE;
-#endif
-
-#ifndef NO_SHA
-    if (XSTRNCMP(alg, "sha", 3) == 0)
-        size = SHA_DIGEST_SIZE;
-#endif
-
-#ifndef NO_SHA256
-    if (XSTRNCMP(alg, "sha256", 6) == 0)
-        size = SHA256_DIGEST_SIZE;
-#endif
+    if (list != NULL) {
+        ret = wolfsslFileListRead(&files, list, delim);
+        if (ret != 0) {
+            wolfsslFileListFree(&files);
+            return ret;
+        }
+    }
+    /* sets default size of each algorithm */
+    for (i = 0; i < hashAlgs.count; i++) {
+        hashAlgs.sizes[i] = wolfsslHashSize(hashAlgs.names[i], size);
+        hashAlgs.total   += hashAlgs.sizes[i];
+    }
+    size = hashAlgs.sizes[0];
 
-#ifdef WOLFSSL_SHA384
-    if (XSTRNCMP(alg, "sha384", 6) == 0)
-        size = SHA384_DIGEST_SIZE;
-#endif
+    if (hashAlgs.count > 1) {
+        if (check != NULL || chunks == 1) {
+            printf("-check and -chunks take a single algorithm\n");
+            wolfsslFileListFree(&files);
+            return FATAL_ERROR;
+        }
+        /* lines have to say which algorithm made them */
+        tag = 1;
+    }
 
-#ifdef WOLFSSL_SHA512
-    if (XSTRNCMP(alg, "sha512", 6) == 0)
-        size = SHA512_DIGEST_SIZE;
+    /* one process for the whole batch, a worker per processor unless
+     * -threads says otherwise
+     */
+    if (io.threads == 0) {
+        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        io.threads = (cpus < 1) ? 1 : (cpus > MAX_THREADS) ?
+                                                MAX_THREADS : (int) cpus;
+    }
+#ifndef HAVE_PTHREAD
+    io.threads = 1;
 #endif
 
-    /* hashing function */
-    wolfsslHash(in, out, alg, size);
+    if (check != NULL)
+        ret = wolfsslHashCheck(check, &files, alg, size, &io, quiet);
+    else if (files.count == 1 && list == NULL && tag == 0 && chunks == 0 &&
+                                                        hashAlgs.count == 1) {
+        /* one -in keeps the original output, a bare digest, and still
+         * hashes text that isn't a file
+         */
+        in = files.names[0];
+        ret = wolfsslHash(in, out, alg, size, &io);
+    }
+    else
+        ret = wolfsslHashFiles(&files, out, &hashAlgs, &io, tag, chunks);
 
-    free(in);
+    wolfsslFileListFree(&files);
 
     return ret;
 }
@@ -0,0 +1,621 @@
+/* wolfsslAsyncIo.c
+ *
+ * Copyright (C) 2006-2015 wolfSSL Inc.
+ *
+ * This file is part of wolfSSL. (formerly known as CyaSSL)
+ *
+ * wolfSSL is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfSSL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ *
+ * Overlapped read -> en/de crypt -> write of one message. Several chunks are
+ * in flight at once so the cipher always has the next chunk ready, either
+ * through io_uring or, without it, through a reader and a writer thread.
+ */
+
+#include "include/wolfssl.h"
+
+#ifdef HAVE_IO_URING
+    #include <linux/io_uring.h>
+    #include <sys/syscall.h>
+    #include <sys/uio.h>
+#endif
+
+/* returned by a backend that can't run here, the caller tries the next */
+#define ASYNC_UNAVAILABLE   1
+
+/* where a chunk buffer is on its way through the pipeline */
+enum {
+    ASYNC_FREE = 0,
+    ASYNC_READING,
+    ASYNC_READ,
+    ASYNC_WRITING
+};
+
+/* a chunk buffer moving through read, en/de crypt and write */
+typedef struct WolfsslAsyncBuf {
+    byte*   data;               /* chunk sized buffer */
+    int64_t pos;                /* offset of the chunk in the message */
+    int     sz;                 /* bytes of input in the chunk */
+    int     outSz;              /* bytes to write once en/de crypted */
+    int     done;               /* bytes read or written so far */
+    int     state;              /* one of the ASYNC_ states */
+} WolfsslAsyncBuf;
+
+/*
+ * en/de crypts one chunk in place, the job's function handles the padding
+ * of the last chunk
+ */
+static int wolfsslAsyncCrypt(WolfsslAsync* job, WolfsslAsyncBuf* buf)
+{
+    int last = (buf->pos + buf->sz == job->length);
+    int ret;
+
+    ret = job->func(job->ctx, buf->data, buf->sz, last);
+    if (ret < 0)
+        return ret;
+    buf->outSz = ret;
+
+    return 0;
+}
+
+/*
+ * no overlap, used when neither backend is available
+ */
+static int wolfsslAsyncSync(WolfsslAsync* job, WolfsslAsyncBuf* buf)
+{
+    int ret = 0;
+
+    for (buf->pos = 0; ret == 0 && buf->pos < job->length;
+                                                        buf->pos += buf->sz) {
+        buf->sz = (job->length - buf->pos < job->chunk) ?
+                                (int)(job->length - buf->pos) : job->chunk;
+
+        if (wolfsslStreamReadAt(job->in, buf->data, buf->sz,
+                                    job->inOffset + buf->pos) != buf->sz)
+            return FREAD_ERROR;
+
+        ret = wolfsslAsyncCrypt(job, buf);
+        if (ret == 0)
+            ret = wolfsslStreamWriteAt(job->out, buf->data, buf->outSz,
+                                                job->outOffset + buf->pos);
+    }
+
+    return ret;
+}
+
+#ifdef HAVE_IO_URING
+
+/* the kernel's submission and completion rings, mapped into our memory */
+typedef struct WolfsslUring {
+    int         fd;             /* ring descriptor */
+    unsigned*   sqHead;         /* advanced by the kernel */
+    unsigned*   sqTail;         /* advanced by us */
+    unsigned*   sqMask;
+    unsigned*   sqArray;
+    unsigned    sqEntries;
+    unsigned*   cqHead;         /* advanced by us */
+    unsigned*   cqTail;         /* advanced by the kernel */
+    unsigned*   cqMask;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+    void*       sqRing;         /* mappings, released by wolfsslUringFree */
+    void*       cqRing;
+    size_t      sqRingSz;
+    size_t      cqRingSz;
+    size_t      sqesSz;
+    unsigned    pending;        /* queued but not yet submitted */
+    int         fixed;          /* chunk buffers are registered */
+} WolfsslUring;
+
+/*
+ * creates a ring with room for entries operations in flight
+ */
+static int wolfsslUringInit(WolfsslUring* ring, unsigned entries)
+{
+    struct io_uring_params p;
+    byte* sq;
+    byte* cq;
+
+    XMEMSET(ring, 0, sizeof(WolfsslUring));
+    XMEMSET(&p, 0, sizeof(p));
+
+    ring->fd = (int) syscall(__NR_io_uring_setup, entries, &p);
+    if (ring->fd < 0)
+        return ASYNC_UNAVAILABLE;
+
+    ring->sqRingSz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cqRingSz = p.cq_off.cqes +
+                                p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cqRingSz > ring->sqRingSz)
+            ring->sqRingSz = ring->cqRingSz;
+        ring->cqRingSz = ring->sqRingSz;
+    }
+
+    ring->sqRing = mmap(NULL, ring->sqRingSz, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sqRing == MAP_FAILED) {
+        close(ring->fd);
+        return ASYNC_UNAVAILABLE;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        ring->cqRing = ring->sqRing;
+    else {
+        ring->cqRing = mmap(NULL, ring->cqRingSz, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cqRing == MAP_FAILED) {
+            munmap(ring->sqRing, ring->sqRingSz);
+            close(ring->fd);
+            return ASYNC_UNAVAILABLE;
+        }
+    }
+    ring->sqesSz = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe*) mmap(NULL, ring->sqesSz,
+                    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        if (ring->cqRing != ring->sqRing)
+            munmap(ring->cqRing, ring->cqRingSz);
+        munmap(ring->sqRing, ring->sqRingSz);
+        close(ring->fd);
+        return ASYNC_UNAVAILABLE;
+    }
+
+    sq = (byte*) ring->sqRing;
+    cq = (byte*) ring->cqRing;
+    ring->sqHead    = (unsigned*)(sq + p.sq_off.head);
+    ring->sqTail    = (unsigned*)(sq + p.sq_off.tail);
+    ring->sqMask    = (unsigned*)(sq + p.sq_off.ring_mask);
+    ring->sqArray   = (unsigned*)(sq + p.sq_off.array);
+    ring->sqEntries = p.sq_entries;
+    ring->cqHead    = (unsigned*)(cq + p.cq_off.head);
+    ring->cqTail    = (unsigned*)(cq + p.cq_off.tail);
+    ring->cqMask    = (unsigned*)(cq + p.cq_off.ring_mask);
+    ring->cqes      = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+    return 0;
+}
+
+/*
+ * unmaps the rings and closes the ring descriptor
+ */
+static void wolfsslUringFree(WolfsslUring* ring)
+{
+    munmap(ring->sqes, ring->sqesSz);
+    if (ring->cqRing != ring->sqRing)
+        munmap(ring->cqRing, ring->cqRingSz);
+    munmap(ring->sqRing, ring->sqRingSz);
+    close(ring->fd);
+}
+
+/*
+ * queues a read or write of the unfinished part of buffer idx
+ */
+static int wolfsslUringQueue(WolfsslUring* ring, WolfsslAsyncBuf* bufs,
+                                int idx, int isWrite, int fd, int64_t offset)
+{
+    WolfsslAsyncBuf*     buf = &bufs[idx];
+    struct io_uring_sqe* sqe;
+    unsigned             tail = *ring->sqTail;
+    unsigned             slot;
+
+    if (tail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE) >=
+                                                            ring->sqEntries)
+        return FATAL_ERROR;
+
+    slot = tail & *ring->sqMask;
+    sqe  = &ring->sqes[slot];
+    XMEMSET(sqe, 0, sizeof(*sqe));
+
+    if (ring->fixed) {
+        sqe->opcode    = isWrite ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+        sqe->buf_index = (unsigned short) idx;
+    }
+    else
+        sqe->opcode    = isWrite ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd        = fd;
+    sqe->off       = (unsigned long long)(offset + buf->done);
+    sqe->addr      = (unsigned long long)(uintptr_t)(buf->data + buf->done);
+    sqe->len       = (unsigned)((isWrite ? buf->outSz : buf->sz) - buf->done);
+    sqe->user_data = ((unsigned long long) idx << 1) | (isWrite ? 1 : 0);
+
+    ring->sqArray[slot] = slot;
+    __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+    ring->pending++;
+
+    return 0;
+}
+
+/*
+ * keeps up to depth chunks in flight through io_uring. Reads complete in
+ * any order, chunks are en/de crypted in message order so cbc chains
+ */
+static int wolfsslAsyncUring(WolfsslAsync* job, WolfsslAsyncBuf* bufs,
+                                                                    int depth)
+{
+    WolfsslUring ring;
+    struct iovec iov[IO_DEPTH];
+    struct io_uring_cqe* cqe;
+
+    int64_t readPos  = 0;       /* next chunk to read */
+    int64_t cryptPos = 0;       /* next chunk to en/de crypt */
+    int64_t written  = 0;       /* input bytes whose output is written */
+    int     inFlight = 0;       /* operations the kernel holds */
+    int     ret      = 0;       /* return variable */
+    int     idx;                /* buffer index */
+    int     isWrite;            /* completion is a write */
+    int     i, got;
+    unsigned head;
+
+    if (wolfsslUringInit(&ring, (unsigned)(2 * depth)) != 0)
+        return ASYNC_UNAVAILABLE;
+
+    /* registered buffers save the kernel mapping them on every operation,
+     * locked memory limits may refuse them and that is fine
+     */
+    for (i = 0; i < depth; i++) {
+        iov[i].iov_base = bufs[i].data;
+        iov[i].iov_len  = (size_t) job->chunk;
+    }
+    ring.fixed = syscall(__NR_io_uring_register, ring.fd,
+                                IORING_REGISTER_BUFFERS, iov, depth) == 0;
+
+    while ((ret == 0 && written < job->length) || inFlight > 0) {
+        /* queue reads into every free buffer */
+        for (i = 0; ret == 0 && i < depth && readPos < job->length; i++) {
+            if (bufs[i].state != ASYNC_FREE)
+                continue;
+            bufs[i].pos   = readPos;
+            bufs[i].sz    = (job->length - readPos < job->chunk) ?
+                                (int)(job->length - readPos) : job->chunk;
+            bufs[i].done  = 0;
+            bufs[i].state = ASYNC_READING;
+            ret = wolfsslUringQueue(&ring, bufs, i, 0, job->in->fd,
+                                                job->inOffset + readPos);
+            readPos += bufs[i].sz;
+            inFlight++;
+        }
+
+        /* submit and wait for at least one completion */
+        got = (int) syscall(__NR_io_uring_enter, ring.fd, ring.pending,
+                                    1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (got < 0) {
+            if (errno == EINTR)
+                continue;
+            /* nothing more can be submitted, drain what the kernel has */
+            if (ret == 0)
+                ret = FATAL_ERROR;
+            if (ring.pending > 0)
+                inFlight -= (int) ring.pending;
+            ring.pending = 0;
+            if (inFlight <= 0)
+                break;
+            continue;
+        }
+        ring.pending -= (unsigned) got;
+
+        head = *ring.cqHead;
+        while (head != __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE)) {
+            cqe     = &ring.cqes[head & *ring.cqMask];
+            idx     = (int)(cqe->user_data >> 1);
+            isWrite = (int)(cqe->user_data & 1);
+            head++;
+            inFlight--;
+
+            if (cqe->res <= 0) {
+                if (ret == 0)
+                    ret = isWrite ? FWRITE_ERROR : FREAD_ERROR;
+                continue;
+            }
+            bufs[idx].done += cqe->res;
+            if (ret != 0)
+                continue;
+
+            if (!isWrite && bufs[idx].done < bufs[idx].sz) {
+                /* short read, ask for the rest */
+                ret = wolfsslUringQueue(&ring, bufs, idx, 0, job->in->fd,
+                                            job->inOffset + bufs[idx].pos);
+                inFlight++;
+            }
+            else if (!isWrite)
+                bufs[idx].state = ASYNC_READ;
+            else if (bufs[idx].done < bufs[idx].outSz) {
+                ret = wolfsslUringQueue(&ring, bufs, idx, 1, job->out->fd,
+                                            job->outOffset + bufs[idx].pos);
+                inFlight++;
+            }
+            else {
+                written += bufs[idx].sz;
+                bufs[idx].state = ASYNC_FREE;
+            }
+        }
+        __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+
+        /* en/de crypt every chunk that is next in line, then write it */
+        for (i = 0; ret == 0 && i < depth; i++) {
+            if (bufs[i].state != ASYNC_READ || bufs[i].pos != cryptPos)
+                continue;
+
+            ret = wolfsslAsyncCrypt(job, &bufs[i]);
+            if (ret != 0)
+                break;
+            cryptPos += bufs[i].sz;
+            bufs[i].done = 0;
+
+            if (bufs[i].outSz == 0) {
+                written += bufs[i].sz;
+                bufs[i].state = ASYNC_FREE;
+            }
+            else {
+                bufs[i].state = ASYNC_WRITING;
+                ret = wolfsslUringQueue(&ring, bufs, i, 1, job->out->fd,
+                                            job->outOffset + bufs[i].pos);
+                inFlight++;
+            }
+            /* the next chunk may be sitting earlier in the array */
+            i = -1;
+        }
+    }
+
+    wolfsslUringFree(&ring);
+
+    return ret;
+}
+
+#endif /* HAVE_IO_URING */
+
+#ifdef HAVE_PTHREAD
+
+#include <sched.h>
+
+#define RING_SPINS  64            /* empty polls before yielding */
+#define RING_YIELDS 256           /* yields before sleeping between polls */
+#define RING_NAP    20000         /* ns slept between polls after that */
+
+/* lock-free ring of chunk buffers handed from one pipeline stage to the
+ * next. Only the producer moves tail and only the consumer moves head, so
+ * neither ever waits on a lock. It holds every buffer, a push never waits.
+ */
+typedef struct WolfsslRing {
+    WolfsslAsyncBuf* items[IO_DEPTH];
+    unsigned         tail;      /* pushed so far, written by the producer */
+    byte             pad[64];   /* head and tail on their own cache lines */
+    unsigned         head;      /* popped so far, written by the consumer */
+    int              closed;    /* no more pushes, pops drain then fail */
+} WolfsslRing;
+
+/* the reader and writer threads' view of the job */
+typedef struct WolfsslAsyncThreads {
+    WolfsslAsync*     job;
+    WolfsslRing       free;     /* writer -> reader */
+    WolfsslRing       full;     /* reader -> cipher */
+    WolfsslRing       done;     /* cipher -> writer */
+} WolfsslAsyncThreads;
+
+static void wolfsslRingPush(WolfsslRing* r, WolfsslAsyncBuf* buf)
+{
+    unsigned tail = r->tail;
+
+    r->items[tail % IO_DEPTH] = buf;
+    __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * waits a little longer each time the ring is found empty, spinning while
+ * the other stage is about to push and sleeping while it waits on I/O
+ */
+static void wolfsslRingBackoff(int* polls)
+{
+    struct timespec nap = { 0, RING_NAP };
+
+    (*polls)++;
+    if (*polls < RING_SPINS)
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    else if (*polls < RING_SPINS + RING_YIELDS)
+        sched_yield();
+    else
+        nanosleep(&nap, NULL);
+}
+
+/* returns NULL once the ring is closed and empty */
+static WolfsslAsyncBuf* wolfsslRingPop(WolfsslRing* r)
+{
+    WolfsslAsyncBuf* buf;
+    unsigned         head  = r->head;
+    int              polls = 0;
+
+    while (__atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == head) {
+        /* a push before the close is still seen after it */
+        if (__atomic_load_n(&r->closed, __ATOMIC_ACQUIRE) &&
+                        __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == head)
+            return NULL;
+        wolfsslRingBackoff(&polls);
+    }
+    buf = r->items[head % IO_DEPTH];
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+
+    return buf;
+}
+
+static void wolfsslRingClose(WolfsslRing* r)
+{
+    __atomic_store_n(&r->closed, 1, __ATOMIC_RELEASE);
+}
+
+/* on error every stage is told to stop */
+static void wolfsslAsyncAbort(WolfsslAsyncThreads* t)
+{
+    wolfsslRingClose(&t->free);
+    wolfsslRingClose(&t->full);
+    wolfsslRingClose(&t->done);
+}
+
+/*
+ * reader stage, fills free buffers with the message in order, a pool task
+ */
+static int wolfsslAsyncReader(void* arg, int worker)
+{
+    WolfsslAsyncThreads* t   = (WolfsslAsyncThreads*) arg;
+    WolfsslAsync*        job = t->job;
+    WolfsslAsyncBuf*     buf;
+    int64_t              pos = 0;
+
+    (void) worker;
+
+    while (pos < job->length && (buf = wolfsslRingPop(&t->free)) != NULL) {
+        if (wolfsslPoolCancelled(NULL)) {
+            wolfsslAsyncAbort(t);
+            return POOL_CANCELLED;
+        }
+        buf->pos = pos;
+        buf->sz  = (job->length - pos < job->chunk) ?
+                                        (int)(job->length - pos) : job->chunk;
+        if (wolfsslStreamReadAt(job->in, buf->data, buf->sz,
+                                        job->inOffset + pos) != buf->sz) {
+            wolfsslAsyncAbort(t);
+            return FREAD_ERROR;
+        }
+        pos += buf->sz;
+        wolfsslRingPush(&t->full, buf);
+    }
+    wolfsslRingClose(&t->full);
+
+    return 0;
+}
+
+/*
+ * writer stage, writes en/de crypted buffers and hands them back, a pool
+ * task
+ */
+static int wolfsslAsyncWriter(void* arg, int worker)
+{
+    WolfsslAsyncThreads* t   = (WolfsslAsyncThreads*) arg;
+    WolfsslAsync*        job = t->job;
+    WolfsslAsyncBuf*     buf;
+
+    (void) worker;
+
+    while ((buf = wolfsslRingPop(&t->done)) != NULL) {
+        if (wolfsslStreamWriteAt(job->out, buf->data, buf->outSz,
+                                        job->outOffset + buf->pos) != 0) {
+            wolfsslAsyncAbort(t);
+            return FWRITE_ERROR;
+        }
+        wolfsslRingPush(&t->free, buf);
+    }
+
+    return 0;
+}
+
+/*
+ * completion of a stage, one dropped by SIGINT before it ran would leave
+ * the others waiting on it
+ */
+static void wolfsslAsyncStaged(void* arg, int ret)
+{
+    if (ret == POOL_CANCELLED)
+        wolfsslAsyncAbort((WolfsslAsyncThreads*) arg);
+}
+
+/*
+ * reader on the pool -> en/de crypt on this thread -> writer on the pool
+ */
+static int wolfsslAsyncThreaded(WolfsslAsync* job, WolfsslAsyncBuf* bufs,
+                                                                    int depth)
+{
+    WolfsslAsyncThreads t;
+    WolfsslAsyncBuf*    buf;
+    WolfsslPool         pool;
+    WolfsslTask         reader;
+    WolfsslTask         writer;
+    int                 ret = 0;
+    int                 i;
+
+    /* the stages wait on each other, both need a thread of their own */
+    wolfsslPoolInit(&pool, 2, 2);
+    if (pool.threads < 2) {
+        wolfsslPoolFree(&pool);
+        return ASYNC_UNAVAILABLE;
+    }
+
+    XMEMSET(&t, 0, sizeof(t));
+    t.job = job;
+    for (i = 0; i < depth; i++)
+        wolfsslRingPush(&t.free, &bufs[i]);
+
+    wolfsslPoolSubmit(&pool, &reader, wolfsslAsyncReader, wolfsslAsyncStaged,
+                                                                        &t);
+    wolfsslPoolSubmit(&pool, &writer, wolfsslAsyncWriter, wolfsslAsyncStaged,
+                                                                        &t);
+
+    /* the reader fills in order, so chunks arrive in message order */
+    while ((buf = wolfsslRingPop(&t.full)) != NULL) {
+        ret = wolfsslAsyncCrypt(job, buf);
+        if (ret != 0) {
+            wolfsslAsyncAbort(&t);
+            break;
+        }
+        wolfsslRingPush(&t.done, buf);
+    }
+    wolfsslRingClose(&t.done);
+
+    wolfsslPoolWait(&pool, &reader);
+    wolfsslPoolWait(&pool, &writer);
+    if (ret == 0)
+        ret = reader.ret != 0 ? reader.ret : writer.ret;
+    wolfsslPoolFree(&pool);
+
+    return ret;
+}
+
+#endif /* HAVE_PTHREAD */
+
+/*
+ * runs the job with the requested backend, falling back from io_uring to
+ * threads to plain reads and writes as availability dictates
+ */
+int wolfsslAsyncRun(WolfsslAsync* job, int backend)
+{
+    WolfsslAsyncBuf bufs[IO_DEPTH];
+    int             ret = ASYNC_UNAVAILABLE;
+    int             i;
+
+    XMEMSET(bufs, 0, sizeof(bufs));
+    for (i = 0; i < IO_DEPTH; i++) {
+        bufs[i].data = wolfsslBufAlloc(job->chunk);
+        if (bufs[i].data == NULL) {
+            ret = MEMORY_E;
+            break;
+        }
+    }
+
+    if (ret != MEMORY_E) {
+#ifdef HAVE_IO_URING
+        if (backend == WOLFSSL_IO_URING)
+            ret = wolfsslAsyncUring(job, bufs, IO_DEPTH);
+#endif
+#ifdef HAVE_PTHREAD
+        if (ret == ASYNC_UNAVAILABLE)
+            ret = wolfsslAsyncThreaded(job, bufs, IO_DEPTH);
+#endif
+        if (ret == ASYNC_UNAVAILABLE)
+            ret = wolfsslAsyncSync(job, &bufs[0]);
+    }
+    (void) backend;
+
+    for (i = 0; i < IO_DEPTH; i++)
+        wolfsslBufFree(bufs[i].data);
+
+    return ret;
+}
@@ -0,0 +1,213 @@
+/* wolfsslBuffer.c
+ *
+ * Copyright (C) 2006-2015 wolfSSL Inc.
+ *
+ * This file is part of wolfSSL. (formerly known as CyaSSL)
+ *
+ * wolfSSL is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfSSL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ *
+ * Recycled data buffers. Sizes round up to a power of two and each size
+ * keeps a free list, so a run that hashes or en/de crypts file after file
+ * or range after range allocates its buffers once. Buffers are wiped once,
+ * when released, and are cache line aligned so ciphers never straddle lines.
+ */
+
+#include "include/wolfssl.h"
+
+#define BUF_ALIGN     64                /* cache line */
+#define BUF_MIN_BITS  6                 /* smallest class, 64 bytes */
+#define BUF_CLASSES   21                /* up to 64 MB, MAX_CHUNK */
+#define BUF_HUGE      (2*MEGABYTE)      /* classes this big are mapped */
+
+/* sits in the cache line before every buffer */
+typedef struct WolfsslBufHead {
+    struct WolfsslBufHead* next;    /* in its class' free list */
+    size_t  used;                   /* bytes asked for, wiped on release */
+    byte*   map;                    /* start of the mapping, if mapped */
+    size_t  mapped;                 /* bytes mapped, 0 if from the heap */
+    int     cls;                    /* size class, -1 for too big to keep */
+} WolfsslBufHead;
+
+/* released buffers of each class, ready to be handed out again */
+static WolfsslBufHead* freeBufs[BUF_CLASSES];
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t bufLock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/*
+ * smallest class holding sz bytes, -1 when none does
+ */
+static int wolfsslBufClass(size_t sz)
+{
+    int cls = 0;
+
+    while (cls < BUF_CLASSES && ((size_t) 1 << (cls + BUF_MIN_BITS)) < sz)
+        cls++;
+
+    return cls < BUF_CLASSES ? cls : -1;
+}
+
+/*
+ * maps a buffer of sz bytes starting on a huge page boundary, the only way
+ * the kernel backs it with transparent huge pages, fewer TLB misses
+ * streaming through it. The header gets the small page just before.
+ */
+static WolfsslBufHead* wolfsslBufMap(size_t sz)
+{
+    WolfsslBufHead* head;
+    size_t  page = (size_t) sysconf(_SC_PAGESIZE);
+    size_t  len;                    /* bytes mapped before trimming */
+    byte*   mem;
+    byte*   data;                   /* huge page aligned buffer */
+
+    sz  = (sz + page - 1) / page * page;
+    len = page + sz + BUF_HUGE;
+    mem = (byte*) mmap(NULL, len, PROT_READ | PROT_WRITE,
+                                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+        return NULL;
+
+    /* keep [data - page, data + sz), give back what is either side */
+    data = (byte*) (((uintptr_t) mem + page + BUF_HUGE - 1) &
+                                                ~((uintptr_t) BUF_HUGE - 1));
+    if (data - page > mem)
+        munmap(mem, (size_t) (data - page - mem));
+    if (data + sz < mem + len)
+        munmap(data + sz, (size_t) (mem + len - (data + sz)));
+#ifdef MADV_HUGEPAGE
+    madvise(data, sz, MADV_HUGEPAGE);
+#endif
+
+    head = (WolfsslBufHead*) (data - BUF_ALIGN);
+    head->map    = data - page;
+    head->mapped = page + sz;
+
+    return head;
+}
+
+/*
+ * gets fresh memory for a buffer of sz bytes, big ones are mapped
+ */
+static WolfsslBufHead* wolfsslBufNew(size_t sz, int cls)
+{
+    WolfsslBufHead* head = NULL;
+    void*           mem;
+
+    if (sz >= BUF_HUGE)
+        head = wolfsslBufMap(sz);
+    if (head == NULL) {
+        if (posix_memalign(&mem, BUF_ALIGN, sz + BUF_ALIGN) != 0)
+            return NULL;
+        head = (WolfsslBufHead*) mem;
+        head->map    = NULL;
+        head->mapped = 0;
+    }
+    head->cls = cls;
+
+    return head;
+}
+
+/*
+ * gives a buffer's memory back to the system
+ */
+static void wolfsslBufRelease(WolfsslBufHead* head)
+{
+    if (head->mapped > 0)
+        munmap(head->map, head->mapped);
+    else
+        free(head);
+}
+
+/*
+ * hands out a released buffer of the right class, or a new one
+ */
+byte* wolfsslBufAlloc(size_t sz)
+{
+    WolfsslBufHead* head = NULL;
+    int             cls  = wolfsslBufClass(sz > 0 ? sz : 1);
+
+    if (cls >= 0) {
+#ifdef HAVE_PTHREAD
+        pthread_mutex_lock(&bufLock);
+#endif
+        head = freeBufs[cls];
+        if (head != NULL)
+            freeBufs[cls] = head->next;
+#ifdef HAVE_PTHREAD
+        pthread_mutex_unlock(&bufLock);
+#endif
+    }
+    if (head == NULL)
+        head = wolfsslBufNew(cls >= 0 ? (size_t) 1 << (cls + BUF_MIN_BITS) :
+                                                                    sz, cls);
+    if (head == NULL)
+        return NULL;
+
+    head->next = NULL;
+    head->used = sz;
+
+    return (byte*) head + BUF_ALIGN;
+}
+
+/*
+ * wipes what the holder could have written and keeps the buffer for the
+ * next wolfsslBufAlloc of its class
+ */
+void wolfsslBufFree(byte* buf)
+{
+    WolfsslBufHead* head;
+
+    if (buf == NULL)
+        return;
+    head = (WolfsslBufHead*) (buf - BUF_ALIGN);
+    XMEMSET(buf, 0, head->used);
+
+    if (head->cls < 0) {
+        wolfsslBufRelease(head);
+        return;
+    }
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&bufLock);
+#endif
+    head->next = freeBufs[head->cls];
+    freeBufs[head->cls] = head;
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&bufLock);
+#endif
+}
+
+/*
+ * returns every kept buffer to the system
+ */
+void wolfsslBufDrain(void)
+{
+    WolfsslBufHead* head;
+    int             cls;            /* loop variable */
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&bufLock);
+#endif
+    for (cls = 0; cls < BUF_CLASSES; cls++) {
+        while ((head = freeBufs[cls]) != NULL) {
+            freeBufs[cls] = head->next;
+            wolfsslBufRelease(head);
+        }
+    }
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&bufLock);
+#endif
+}
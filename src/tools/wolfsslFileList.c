@@ -0,0 +1,123 @@
+/* wolfsslFileList.c
+ *
+ * Copyright (C) 2006-2015 wolfSSL Inc.
+ *
+ * This file is part of wolfSSL. (formerly known as CyaSSL)
+ *
+ * wolfSSL is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfSSL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "include/wolfssl.h"
+
+/*
+ * appends a copy of name to the list, growing it as needed
+ */
+int wolfsslFileListAdd(WolfsslFileList* list, const char* name)
+{
+    char**  names;              /* grown array of names */
+    int     cap;                /* new capacity */
+    size_t  len = strlen(name); /* length of the name */
+
+    if (list->count == list->cap) {
+        cap   = (list->cap == 0) ? 16 : list->cap * 2;
+        names = (char**) realloc(list->names, cap * sizeof(char*));
+        if (names == NULL)
+            return MEMORY_E;
+        list->names = names;
+        list->cap   = cap;
+    }
+
+    list->names[list->count] = (char*) malloc(len + 1);
+    if (list->names[list->count] == NULL)
+        return MEMORY_E;
+    XMEMCPY(list->names[list->count], name, len + 1);
+    list->count++;
+
+    return 0;
+}
+
+/*
+ * adds every name in a list file, "-" reads the list from stdin. Names are
+ * separated by delim, empty names are skipped
+ */
+int wolfsslFileListRead(WolfsslFileList* list, const char* file, int delim)
+{
+    FILE*   listFile;           /* file holding the names */
+    char*   line = NULL;        /* one name, grown by getdelim */
+    size_t  lineSz = 0;         /* allocated size of line */
+    ssize_t got;                /* length of the name read */
+    int     ret = 0;            /* return variable */
+
+    if (strcmp(file, "-") == 0)
+        listFile = stdin;
+    else
+        listFile = fopen(file, "rb");
+    if (listFile == NULL) {
+        printf("Failed to open list file %s\n", file);
+        return FREAD_ERROR;
+    }
+
+    while (ret == 0 && (got = getdelim(&line, &lineSz, delim, listFile)) > 0) {
+        if (line[got - 1] == (char) delim)
+            line[--got] = '\0';
+        if (delim == '\n' && got > 0 && line[got - 1] == '\r')
+            line[--got] = '\0';
+        if (got > 0)
+            ret = wolfsslFileListAdd(list, line);
+    }
+    if (ret == 0 && ferror(listFile))
+        ret = FREAD_ERROR;
+
+    free(line);
+    if (listFile != stdin)
+        fclose(listFile);
+
+    return ret;
+}
+
+/*
+ * stats every file in the list, 0 for any that can't be stat'ed
+ */
+int64_t* wolfsslFileListSizes(const WolfsslFileList* list)
+{
+    int64_t*    sizes;          /* one per name */
+    struct stat st;             /* what stat found */
+    int         i;              /* loop variable */
+
+    sizes = (int64_t*) calloc(list->count > 0 ? list->count : 1,
+                                                            sizeof(int64_t));
+    if (sizes == NULL)
+        return NULL;
+
+    for (i = 0; i < list->count; i++) {
+        if (stat(list->names[i], &st) == 0 && S_ISREG(st.st_mode))
+            sizes[i] = (int64_t) st.st_size;
+    }
+
+    return sizes;
+}
+
+/*
+ * frees every name and the list itself
+ */
+void wolfsslFileListFree(WolfsslFileList* list)
+{
+    int i;                      /* loop variable */
+
+    for (i = 0; i < list->count; i++)
+        free(list->names[i]);
+    free(list->names);
+    XMEMSET(list, 0, sizeof(WolfsslFileList));
+}
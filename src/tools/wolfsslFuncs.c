@@ -27,7 +27,6 @@
 
 /*end type casting */
 
-int     loop       =   1;       /* benchmarking loop */
 int     i          =   0;       /* loop variable */
 
 /*
@@ -53,6 +52,14 @@ int     i          =   0;       /* loop variable */
     printf("-verify         when using -iv and -key this will print result of\n"
            "                encryption for user verification.\n"
            "                This flag takes no arguments.\n");
+    printf("-chunk          bytes to en/de crypt at a time, accepts k, m or g\n"
+           "                suffixes. Default: %d\n", DEFAULT_CHUNK);
+    printf("-threads        worker threads for aes-ctr en/de cryption,\n"
+           "                cbc decryption, hashing and benchmarks\n");
+    printf("-mmap           map files instead of reading them, used by\n"
+           "                encrypt, decrypt and hash\n");
+    printf("-io             uring, thread or sync. Overlaps reading and\n"
+           "                writing with en/de cryption. Default: sync\n");
     printf("-time           used by Benchmark, set time in seconds to run.\n");
     printf("-verbose        display a more verbose help menu\n");
 
@@ -90,39 +97,6 @@ void wolfsslVerboseHelp()
 #endif
         };
 
-    /* benchmark options */
-    const char* algsother[] = {      /* list of acceptable algorithms */
-#ifndef NO_AES
-            "aes-cbc"
-#endif
-#ifdef WOLFSSL_AES_COUNTER
-                , "aes-ctr"
-#endif
-#ifndef NO_DES3
-                , "3des"
-#endif
-#ifdef HAVE_CAMELLIA
-                , "camellia"
-#endif
-#ifndef NO_MD5
-                , "md5"
-#endif
-#ifndef NO_SHA
-                , "sha"
-#endif
-#ifndef NO_SHA256
-                , "sha256"
-#endif
-#ifdef WOLFSSL_SHA384
-                , "sha384"
-#endif
-#ifdef WOLFSSL_SHA512
-                , "sha512"
-#endif
-#ifdef HAVE_BLAKE2
-                , "blake2b"
-#endif
-        };
         wolfsslHelp();
 
         printf("Available En/De crypt Algorithms with current configure "
@@ -149,8 +123,9 @@ void wolfsslVerboseHelp()
     printf("Available benchmark tests with current configure settings:\n");
     printf("(-a to test all)\n\n");
 
-    for(i = 0; i < (int) sizeof(algsother)/(int) sizeof(algsother[0]); i++) {
-        printf("%s\n", algsother[i]);
+    /* from the table -bench runs */
+    for (i = 0; wolfsslBenchName(i) != NULL; i++) {
+        printf("%s\n", wolfsslBenchName(i));
     }
 }
 
@@ -180,6 +155,10 @@ void wolfsslEncryptHelp()
     printf("***************************************************************\n");
     printf("\nEXAMPLE: \n\nwolfssl -encrypt aes-cbc-128 -pwd Thi$i$myPa$$w0rd"
            " -in somefile.txt -out encryptedfile.txt\n\n");
+    printf("-kdf-iter N derives the key with N PBKDF2 iterations instead of\n"
+           "%d. -kdf-target-ms ms picks the count that takes ms\n"
+           "milliseconds on this machine. The count is written to the\n"
+           "file and -decrypt reads it back.\n\n", KDF_ITERATIONS);
 }
 
 /*
@@ -247,6 +226,23 @@ void wolfsslHashHelp()
     printf("\nUSAGE: wolfssl -hash <-algorithm> -in <file to hash>\n");
     printf("***************************************************************\n");
     printf("\nEXAMPLE: \n\nwolfssl -hash sha -in <some file>\n\n");
+    printf("Several files may follow -in, or come from -inlist <file>, one\n"
+           "name per line (-null for NUL separated, - for stdin). Each file\n"
+           "gets a sha256sum style line, -tag prints BSD style lines and\n"
+           "-threads sets how many files are hashed at once.\n\n");
+    printf("wolfssl -hash sha256 -in a.dat b.dat c.dat\n");
+    printf("find . -type f -print0 | wolfssl -hash sha256 -inlist - -null\n\n");
+    printf("Algorithms may be combined with commas to get every digest from\n"
+           "a single read of each file, printed as -tag style lines.\n\n");
+    printf("wolfssl -hash md5,sha,sha256 -in release.tar.gz\n\n");
+    printf("-check <manifest> verifies the files a sha256sum or -tag style\n"
+           "manifest lists, printing OK or FAILED per file and a summary.\n"
+           "Bare digests, like tests/byte-hashes.sha1, are paired in order\n"
+           "with the -in files. -quiet only prints failures. -chunks adds\n"
+           "a digest per -chunk bytes to the output, which lets -check\n"
+           "stop reading a file at its first bad chunk.\n\n");
+    printf("wolfssl -hash sha256 -in *.dat -chunks -chunk 1m -out sums\n");
+    printf("wolfssl -hash sha256 -check sums -quiet\n\n");
 }
 
 /*
@@ -255,43 +251,11 @@ void wolfsslHashHelp()
 void wolfsslBenchHelp()
 {
     printf("\n");
-        /* benchmark options */
-    const char* algsother[] = {      /* list of acceptable algorithms */
-#ifndef NO_AES
-            "aes-cbc"
-#endif
-#ifdef WOLFSSL_AES_COUNTER
-                , "aes-ctr"
-#endif
-#ifndef NO_DES3
-                , "3des"
-#endif
-#ifdef HAVE_CAMELLIA
-                , "camellia"
-#endif
-#ifndef NO_MD5
-                , "md5"
-#endif
-#ifndef NO_SHA
-                , "sha"
-#endif
-#ifndef NO_SHA256
-                , "sha256"
-#endif
-#ifdef WOLFSSL_SHA384
-                , "sha384"
-#endif
-#ifdef WOLFSSL_SHA512
-                , "sha512"
-#endif
-#ifdef HAVE_BLAKE2
-                , "blake2b"
-#endif
-        };
     printf("\nAvailable tests: (-a to test all)\n");
     printf("Available tests with current configure settings:\n");
-    for(i = 0; i < (int) sizeof(algsother)/(int) sizeof(algsother[0]); i++) {
-        printf("%s\n", algsother[i]);
+    /* from the table -bench runs */
+    for (i = 0; wolfsslBenchName(i) != NULL; i++) {
+        printf("%s\n", wolfsslBenchName(i));
     }
     printf("\n");
             /* encryption/decryption help lists options */
@@ -301,6 +265,50 @@ void wolfsslBenchHelp()
     printf("***************************************************************\n");
     printf("\nEXAMPLE: \n\nwolfssl -bench aes-cbc -time 10"
            " -in encryptedfile.txt -out decryptedfile.txt\n\n");
+    printf("Ciphers are timed encrypting, decrypting and setting up keys\n"
+           "(key setups per second) at every key size, aes and camellia\n"
+           "128, 192 and 256 and 3des 56, 112 and 168. -ops takes a comma\n"
+           "separated list of encrypt, decrypt and keysetup to time fewer.\n"
+           "aes-ctr decrypts by encrypting so it has no decrypt test.\n\n");
+    printf("wolfssl -bench aes-cbc -ops keysetup -time 1\n\n");
+    printf("-sizes <list> runs every test at each size in the list, bytes\n"
+           "per call with optional k, m or g suffixes, and prints a table of\n"
+           "MB/s by size. A bare -sizes sweeps 16,64,256,1k,8k,16k,64k,1m.\n"
+           "-time applies to each size.\n\n");
+    printf("wolfssl -bench aes-cbc -sizes 16,1k,64k -time 1\n\n");
+    printf("-threads N runs every test on 1 thread and then on N threads\n"
+           "at once, each pinned to a processor with its own context and\n"
+           "buffers. -threads 1..N doubles the threads from 1 up to N.\n"
+           "Prints aggregate and per thread MB/s and the scaling\n"
+           "efficiency against 1 thread.\n\n");
+    printf("wolfssl -bench sha256 -threads 1..16 -time 1\n\n");
+    printf("-reps N times every test N times, each after a short warmup,\n"
+           "and prints the min, median, mean, standard deviation and 95th\n"
+           "percentile MB/s. Tables show the median. Results whose runs\n"
+           "vary by more than 5%% are flagged as noisy.\n\n");
+    printf("wolfssl -bench -all -reps 5 -time 1\n\n");
+    printf("-format json|csv prints the results for other programs to\n"
+           "read instead of the tables, with the processor, system and\n"
+           "wolfSSL version they were measured on.\n"
+           "-baseline <file> compares the results with a file written by\n"
+           "-format json and exits with 2 when any is more than\n"
+           "-threshold percent slower, 10 by default.\n\n");
+    printf("wolfssl -bench -all -format json > base.json\n"
+           "wolfssl -bench -all -baseline base.json -threshold 5\n\n");
+    printf("-latency times every call on its own, the context set up\n"
+           "and the message encrypted or hashed, into a histogram, and\n"
+           "prints the p50, p90, p99, p99.9 and max nanoseconds for each\n"
+           "test at each size, 1k, 2k and 4k unless -sizes says otherwise.\n"
+           "With -threads every thread runs at once into one histogram.\n"
+           "-baseline compares latency results at p99.\n\n");
+    printf("wolfssl -bench aes-cbc sha256 -latency -time 1\n\n");
+    printf("file runs encrypt, decrypt and hash on a generated file of\n"
+           "-size bytes, 256m by default, through the same code as the\n"
+           "encrypt, decrypt and hash commands. Each stage's output is\n"
+           "synced to disk and dropped from the page cache, and its time\n"
+           "is split into read, crypto, write and PBKDF2. The decrypted\n"
+           "file is checked against the original byte for byte.\n\n");
+    printf("wolfssl -bench file -size 4g\n\n");
 }
 
 /*
@@ -392,7 +400,8 @@ int wolfsslGetAlgo(char* name, char** alg, char** mode, int* size)
 /*
  * makes a cyptographically secure key by stretching a user entered pwdKey
  */
-int wolfsslGenKey(RNG* rng, byte* pwdKey, int size, byte* salt, int pad)
+int wolfsslGenKey(RNG* rng, byte* pwdKey, int size, byte* salt, int pad,
+                                                                int iterations)
 {
     int ret;        /* return variable */
 
@@ -408,16 +417,57 @@ int wolfsslGenKey(RNG* rng, byte* pwdKey, int size, byte* salt, int pad)
      */
     if (pad == 0)
         salt[0] = 0;
+    else if (salt[0] == 0)
+        salt[0] = 1;
+
+    /* the last value tells decryption an iteration count follows the salt */
+    salt[SALT_SIZE-1] = (iterations != KDF_ITERATIONS) ? KDF_COUNT_FLAG : 0;
 
-    /* stretches pwdKey */
+    /* stretches pwdKey, only as far as the cipher reads */
     ret = (int) wc_PBKDF2(pwdKey, pwdKey, (int) strlen((const char*)pwdKey), salt, SALT_SIZE,
-                                                            4096, size, SHA256);
+                                        iterations, KDF_KEY_SIZE(size), SHA256);
     if (ret != 0)
         return ret;
 
     return 0;
 }
 
+/*
+ * finds the PBKDF2 iteration count that takes about targetMs here
+ */
+int wolfsslKdfCalibrate(double targetMs, int size)
+{
+    const byte pwd[]  = "calibrate";    /* stand in password */
+    byte    salt[SALT_SIZE] = {0};      /* stand in salt */
+    byte    key[KDF_KEY_SIZE(256)];     /* derived key, thrown away */
+    int     iterations = KDF_MIN_ITERATIONS;    /* count timed */
+    double  start;                      /* clock before the derivation */
+    double  ms = 0;                     /* how long it took */
+    double  scaled;                     /* count that would take targetMs */
+
+    for (;;) {
+        start = wolfsslGetTime();
+        if (wc_PBKDF2(key, pwd, (int) sizeof(pwd) - 1, salt, SALT_SIZE,
+                            iterations, KDF_KEY_SIZE(size), SHA256) != 0)
+            return KDF_ITERATIONS;
+        ms = (wolfsslGetTime() - start) * 1000;
+        /* long enough that clock granularity and noise don't matter */
+        if (ms >= targetMs / 4 || ms >= 100 ||
+                                        iterations >= KDF_MAX_ITERATIONS / 2)
+            break;
+        iterations *= 2;
+    }
+    XMEMSET(key, 0, sizeof(key));
+
+    scaled = (ms > 0) ? iterations * targetMs / ms : KDF_MAX_ITERATIONS;
+    if (scaled < KDF_MIN_ITERATIONS)
+        return KDF_MIN_ITERATIONS;
+    if (scaled > KDF_MAX_ITERATIONS)
+        return KDF_MAX_ITERATIONS;
+
+    return (int) scaled;
+}
+
 /*
  * secure data entry by turning off key echoing in the terminal
  */
@@ -469,39 +519,107 @@ void wolfsslAppend(char* s, char c)
 }
 
 /*
- * resets benchmarking loop
+ * parses a size such as "16384", "64k", "1m" or "4g" into bytes
  */
-void wolfsslStop(int signo)
+int wolfsslParseSize(const char* str, int64_t* size)
 {
-    (void) signo; /* type cast to void for unused variable */
-    loop = 0;
+    char*   end;        /* first character after the number */
+    int64_t value;      /* the number before any suffix */
+    int64_t mult = 1;   /* bytes per unit of the suffix */
+
+    if (str == NULL)
+        return FATAL_ERROR;
+
+    errno = 0;
+    value = (int64_t) strtoll(str, &end, 10);
+    if (errno != 0 || end == str || value < 0)
+        return FATAL_ERROR;
+
+    switch (*end) {
+        case '\0':                                            break;
+        case 'k': case 'K': mult = 1024;                      end++; break;
+        case 'm': case 'M': mult = MEGABYTE;                  end++; break;
+        case 'g': case 'G': mult = (int64_t) MEGABYTE * 1024; end++; break;
+        default:            return FATAL_ERROR;
+    }
+    /* a size too big for 64 bits is refused, not wrapped */
+    if (*end != '\0' || value > INT64_MAX / mult)
+        return FATAL_ERROR;
+
+    *size = value * mult;
+    return 0;
 }
 
 /*
- * gets current time durring program execution
+ * gets current time durring program execution, from the monotonic clock so
+ * the benchmarks aren't thrown off by the wall clock being set
  */
 double wolfsslGetTime(void)
 {
-    struct timeval tv;
+    struct timespec ts;
 
-    gettimeofday(&tv, 0);
+    clock_gettime(CLOCK_MONOTONIC, &ts);
 
-    return (double)tv.tv_sec + (double)tv.tv_usec / 1000000;
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000;
+}
+
+/*
+ * starts timing a phase, only when phases are being collected
+ */
+double wolfsslPhaseStart(const WolfsslIo* io)
+{
+    return (io != NULL && io->phases != NULL) ? wolfsslGetTime() : 0;
+}
+
+/*
+ * adds the time since start to a phase
+ */
+void wolfsslPhaseEnd(const WolfsslIo* io, int phase, double start)
+{
+    if (io != NULL && io->phases != NULL)
+        io->phases->seconds[phase] += wolfsslGetTime() - start;
+}
+
+/*
+ * reads the processor's time stamp counter, 0 where there isn't one
+ */
+uint64_t wolfsslCycles(void)
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    unsigned int lo, hi;
+
+    __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+    return ((uint64_t) hi << 32) | lo;
+#else
+    return 0;
+#endif
 }
 
 /*
  * prints out stats for benchmarking
  */
-void wolfsslStats(double start, int blockSize, int64_t blocks)
+void wolfsslStats(double seconds, uint64_t cycles, int blockSize,
+                                                                int64_t blocks)
 {
     double mbs;
-    double time_total = wolfsslGetTime() - start;
 
-    printf("took %6.3f seconds, blocks = %llu\n", time_total,
+    printf("took %6.3f seconds, blocks = %llu\n", seconds,
             (unsigned long long)blocks);
 
-    mbs = ((blocks * blockSize) / MEGABYTE) / time_total;
+    if (blockSize == 0) {
+        /* key setups or derivations, a block is one key */
+        printf("Keys/s       = %8.0f\n", (double) blocks / seconds);
+        if (cycles > 0 && blocks > 0)
+            printf("Cycles/key   = %8.0f\n", (double) cycles / blocks);
+        printf("\n");
+        return;
+    }
+
+    mbs = ((double) blocks * blockSize / MEGABYTE) / seconds;
     printf("Average MB/s = %8.1f\n", mbs);
+    if (cycles > 0 && blocks > 0)
+        printf("Cycles/byte  = %8.2f\n",
+                                (double) cycles / ((double) blocks * blockSize));
     if (blockSize != MEGABYTE)
         printf("Block size of this algorithm is: %d.\n\n", blockSize);
     else
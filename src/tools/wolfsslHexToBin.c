@@ -30,18 +30,28 @@
 #include <wolfssl/wolfcrypt/coding.h>
 #include <wolfssl/wolfcrypt/error-crypt.h>
 #include <stdio.h>
-//#include <include/wolfssl.h>
+#include "include/wolfssl.h"
 
-/* free up to 5 binary buffers using wolfssl abstraction layer */
+/* wipe and release up to 5 binary buffers from wolfsslBufAlloc */
 void wolfsslFreeBins(byte* b1, byte* b2, byte* b3, byte* b4, byte* b5)
 {
-   XFREE(b1, NULL, DYNAMIC_TYPE_TMP_BUFFER);
-   XFREE(b2, NULL, DYNAMIC_TYPE_TMP_BUFFER);
-   XFREE(b3, NULL, DYNAMIC_TYPE_TMP_BUFFER);
-   XFREE(b4, NULL, DYNAMIC_TYPE_TMP_BUFFER);
-   XFREE(b5, NULL, DYNAMIC_TYPE_TMP_BUFFER);
+   wolfsslBufFree(b1);
+   wolfsslBufFree(b2);
+   wolfsslBufFree(b3);
+   wolfsslBufFree(b4);
+   wolfsslBufFree(b5);
 }
 
+/* convert hex string into the caller's buffer of *bSz bytes, store size */
+int wolfsslHexToBuf(const char* h, byte* b, word32* bSz)
+{
+    if (h == NULL || b == NULL || bSz == NULL)
+        return BAD_FUNC_ARG;
+    if ((word32)XSTRLEN(h) / 2 > *bSz)
+        return BUFFER_E;
+
+    return Base16_Decode((const byte*)h, (int)XSTRLEN(h), b, bSz);
+}
 
 /* convert hex string to binary, store size, 0 success (free mem on failure) */
 int wolfsslHexToBin(const char* h1, byte** b1, word32* b1Sz,
@@ -54,7 +64,7 @@ int wolfsslHexToBin(const char* h1, byte** b1, word32* b1Sz,
     /* b1 */
     if (h1 && b1 && b1Sz) {
         *b1Sz = (int)XSTRLEN(h1) / 2;
-        *b1   = XMALLOC(*b1Sz, NULL, DYNAMIC_TYPE_TMP_BUFFER);
+        *b1   = wolfsslBufAlloc(*b1Sz);
         if (*b1 == NULL)
             return MEMORY_E;
         ret = Base16_Decode((const byte*)h1, (int)XSTRLEN(h1), *b1, b1Sz);
@@ -67,7 +77,7 @@ int wolfsslHexToBin(const char* h1, byte** b1, word32* b1Sz,
     /* b2 */
     if (h2 && b2 && b2Sz) {
         *b2Sz = (int)XSTRLEN(h2) / 2;
-        *b2   = XMALLOC(*b2Sz, NULL, DYNAMIC_TYPE_TMP_BUFFER);
+        *b2   = wolfsslBufAlloc(*b2Sz);
         if (*b2 == NULL) {
             wolfsslFreeBins(b1 ? *b1 : NULL, NULL, NULL, NULL, NULL);
             return MEMORY_E;
@@ -82,7 +92,7 @@ int wolfsslHexToBin(const char* h1, byte** b1, word32* b1Sz,
     /* b3 */
     if (h3 && b3 && b3Sz) {
         *b3Sz = (int)XSTRLEN(h3) / 2;
-        *b3   = XMALLOC(*b3Sz, NULL, DYNAMIC_TYPE_TMP_BUFFER);
+        *b3   = wolfsslBufAlloc(*b3Sz);
         if (*b3 == NULL) {
             wolfsslFreeBins(b1 ? *b1 : NULL, b2 ? *b2 : NULL, NULL, NULL, NULL);
             return MEMORY_E;
@@ -97,7 +107,7 @@ int wolfsslHexToBin(const char* h1, byte** b1, word32* b1Sz,
     /* b4 */
     if (h4 && b4 && b4Sz) {
         *b4Sz = (int)XSTRLEN(h4) / 2;
-        *b4   = XMALLOC(*b4Sz, NULL, DYNAMIC_TYPE_TMP_BUFFER);
+        *b4   = wolfsslBufAlloc(*b4Sz);
         if (*b4 == NULL) {
             wolfsslFreeBins(b1 ? *b1 : NULL,b2 ? *b2 : NULL,b3 ? *b3 :
                                                                 NULL,NULL,NULL);
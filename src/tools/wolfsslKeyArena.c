@@ -0,0 +1,171 @@
+/* wolfsslKeyArena.c
+ *
+ * Copyright (C) 2006-2015 wolfSSL Inc.
+ *
+ * This file is part of wolfSSL. (formerly known as CyaSSL)
+ *
+ * wolfSSL is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfSSL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ *
+ * Locked memory for passwords, keys and IVs. Regions of fixed size slots are
+ * mapped between inaccessible guard pages, locked into memory once and left
+ * out of core dumps, so no key is ever swapped or dumped and taking a slot
+ * costs no system call. Free slots are linked through their first bytes.
+ */
+
+#include "include/wolfssl.h"
+
+#define KEY_REGION (64*1024)            /* slot bytes mapped at a time */
+
+/* one mapping of slots */
+typedef struct WolfsslKeyRegion {
+    struct WolfsslKeyRegion* next;  /* mapped before it */
+    byte*   map;                    /* the mapping, guard pages included */
+    size_t  mapSz;                  /* bytes mapped */
+    byte*   slots;                  /* first slot, past the low guard page */
+    size_t  slotsSz;                /* bytes of slots */
+    int     locked;                 /* mlock succeeded */
+} WolfsslKeyRegion;
+
+static WolfsslKeyRegion* keyRegions;    /* every mapping */
+static byte*             freeKeys;      /* first free slot */
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t keyLock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/*
+ * maps another region of slots and adds them to the free list. Called with
+ * the lock held.
+ */
+static int wolfsslKeyGrow(void)
+{
+    WolfsslKeyRegion* region;
+    size_t  page = (size_t) sysconf(_SC_PAGESIZE);
+    size_t  off;                    /* walks the slots */
+
+    region = (WolfsslKeyRegion*) calloc(1, sizeof(WolfsslKeyRegion));
+    if (region == NULL)
+        return MEMORY_E;
+
+    region->slotsSz = (KEY_REGION + page - 1) / page * page;
+    region->mapSz   = region->slotsSz + 2 * page;
+    region->map = (byte*) mmap(NULL, region->mapSz, PROT_NONE,
+                                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region->map == MAP_FAILED) {
+        free(region);
+        return MEMORY_E;
+    }
+    /* an overrun of the first or last slot faults on a guard page */
+    region->slots = region->map + page;
+    if (mprotect(region->slots, region->slotsSz,
+                                            PROT_READ | PROT_WRITE) != 0) {
+        munmap(region->map, region->mapSz);
+        free(region);
+        return MEMORY_E;
+    }
+#ifdef MADV_DONTDUMP
+    madvise(region->slots, region->slotsSz, MADV_DONTDUMP);
+#endif
+    /* RLIMIT_MEMLOCK may refuse, the keys still work, only swappable */
+    region->locked = (mlock(region->slots, region->slotsSz) == 0);
+
+    for (off = 0; off + KEY_SLOT_SIZE <= region->slotsSz;
+                                                    off += KEY_SLOT_SIZE) {
+        *(byte**) (region->slots + off) = freeKeys;
+        freeKeys = region->slots + off;
+    }
+    region->next = keyRegions;
+    keyRegions   = region;
+
+    return 0;
+}
+
+/*
+ * takes a free slot, zeroed
+ */
+byte* wolfsslKeyAlloc(size_t sz)
+{
+    byte* key = NULL;
+
+    if (sz > KEY_SLOT_SIZE)
+        return NULL;
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&keyLock);
+#endif
+    if (freeKeys != NULL || wolfsslKeyGrow() == 0) {
+        key = freeKeys;
+        freeKeys = *(byte**) key;
+        *(byte**) key = NULL;
+    }
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&keyLock);
+#endif
+
+    return key;
+}
+
+/*
+ * wipes a slot and puts it back on the free list
+ */
+void wolfsslKeyFree(byte* key)
+{
+    if (key == NULL)
+        return;
+
+    XMEMSET(key, 0, KEY_SLOT_SIZE);
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&keyLock);
+#endif
+    *(byte**) key = freeKeys;
+    freeKeys = key;
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&keyLock);
+#endif
+}
+
+/*
+ * frees up to 3 slots, the password, key and IV of an en/de cryption
+ */
+void wolfsslFreeKeys(byte* k1, byte* k2, byte* k3)
+{
+    wolfsslKeyFree(k1);
+    wolfsslKeyFree(k2);
+    wolfsslKeyFree(k3);
+}
+
+/*
+ * wipes, unlocks and unmaps every region
+ */
+void wolfsslKeyDrain(void)
+{
+    WolfsslKeyRegion* region;
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&keyLock);
+#endif
+    while ((region = keyRegions) != NULL) {
+        keyRegions = region->next;
+        XMEMSET(region->slots, 0, region->slotsSz);
+        if (region->locked)
+            munlock(region->slots, region->slotsSz);
+        munmap(region->map, region->mapSz);
+        free(region);
+    }
+    freeKeys = NULL;
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&keyLock);
+#endif
+}
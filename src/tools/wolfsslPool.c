@@ -0,0 +1,449 @@
+/* wolfsslPool.c
+ *
+ * Copyright (C) 2006-2015 wolfSSL Inc.
+ *
+ * This file is part of wolfSSL. (formerly known as CyaSSL)
+ *
+ * wolfSSL is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfSSL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ *
+ * The worker threads every threaded part of the tool runs on. Tasks are
+ * queued in order onto a bounded queue and each has a future the caller
+ * waits on. Running tasks can spawn more onto their worker's deque, which
+ * idle workers steal from. One lock guards it all, tasks are chunks of
+ * file I/O and crypto that dwarf the cost of taking it. SIGINT cancels:
+ * queued tasks are dropped and running ones stop at their next
+ * wolfsslPoolCancelled check.
+ */
+
+#include "include/wolfssl.h"
+
+/* set by the SIGINT handler, never cleared */
+static volatile sig_atomic_t interrupted = 0;
+
+/*
+ * SIGINT handler, only async signal safe calls in here. The handler is
+ * reset on entry so a second SIGINT ends the process at once.
+ */
+static void wolfsslPoolSignal(int sig)
+{
+    static const char msg[] = "\nwolfssl: interrupted, stopping\n";
+    ssize_t n;
+
+    (void) sig;
+    interrupted = 1;
+    n = write(STDERR_FILENO, msg, sizeof(msg) - 1);
+    (void) n;
+}
+
+/*
+ * installs the SIGINT handler the first time a pool starts, unless SIGINT
+ * is already handled or ignored
+ */
+static void wolfsslPoolCatch(void)
+{
+    static int       caught = 0;    /* handler already looked at */
+    struct sigaction sa;            /* the handler */
+    struct sigaction old;           /* what was there */
+
+    if (caught)
+        return;
+    caught = 1;
+
+    if (sigaction(SIGINT, NULL, &old) != 0 || old.sa_handler != SIG_DFL)
+        return;
+
+    XMEMSET(&sa, 0, sizeof(sa));
+    sa.sa_handler = wolfsslPoolSignal;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESETHAND;
+    sigaction(SIGINT, &sa, NULL);
+}
+
+/*
+ * marks a task done with ret, after calling its completion callback
+ */
+static void wolfsslPoolFinish(WolfsslPool* pool, WolfsslTask* task, int ret)
+{
+    task->ret = ret;
+    if (task->done != NULL)
+        task->done(task->arg, ret);
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&pool->lock);
+#endif
+    task->state = WOLFSSL_TASK_DONE;
+#ifdef HAVE_PTHREAD
+    pthread_cond_broadcast(&pool->finished);
+    pthread_mutex_unlock(&pool->lock);
+#else
+    (void) pool;
+#endif
+}
+
+#ifdef HAVE_PTHREAD
+
+/*
+ * cancels the pool and finishes every queued and spawned task as
+ * POOL_CANCELLED. Called and returns with the lock held.
+ */
+static void wolfsslPoolDrop(WolfsslPool* pool)
+{
+    WolfsslTask* dropped = pool->head;  /* every task dropped */
+    WolfsslTask* task;                  /* walks them */
+    WolfsslTask* next;                  /* the one after it */
+    int          i;                     /* loop variable */
+
+    /* the deques are chained onto the queue, they hold only their own */
+    for (i = 0; i < pool->next; i++) {
+        if (pool->deques[i].head == NULL)
+            continue;
+        pool->deques[i].tail->next = dropped;
+        dropped = pool->deques[i].head;
+        pool->deques[i].head = pool->deques[i].tail = NULL;
+    }
+
+    pool->cancelled = 1;
+    pool->head      = NULL;
+    pool->tail      = NULL;
+    pool->queued    = 0;
+    pool->spawned   = 0;
+    pthread_cond_broadcast(&pool->room);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (task = dropped; task != NULL; task = next) {
+        next = task->next;
+        wolfsslPoolFinish(pool, task, POOL_CANCELLED);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+}
+
+/*
+ * the next task for worker: its newest spawned one, else the oldest
+ * submitted one, else the oldest spawned one of another worker. Called
+ * with the lock held, returns NULL when there is nothing to do.
+ */
+static WolfsslTask* wolfsslPoolTake(WolfsslPool* pool, int worker)
+{
+    WolfsslDeque* deque = &pool->deques[worker];
+    WolfsslTask*  task;
+    int           i;            /* loop variable */
+
+    if (deque->tail != NULL) {
+        task = deque->tail;
+        deque->tail = task->prev;
+        if (deque->tail != NULL)
+            deque->tail->next = NULL;
+        else
+            deque->head = NULL;
+        pool->spawned--;
+        return task;
+    }
+
+    if (pool->head != NULL) {
+        task = pool->head;
+        pool->head = task->next;
+        if (pool->head == NULL)
+            pool->tail = NULL;
+        pool->queued--;
+        pthread_cond_signal(&pool->room);
+        return task;
+    }
+
+    /* steal, starting with the next worker so thieves spread out */
+    for (i = 1; pool->spawned > 0 && i < pool->next; i++) {
+        deque = &pool->deques[(worker + i) % pool->next];
+        if (deque->head == NULL)
+            continue;
+        task = deque->head;
+        deque->head = task->next;
+        if (deque->head != NULL)
+            deque->head->prev = NULL;
+        else
+            deque->tail = NULL;
+        pool->spawned--;
+        return task;
+    }
+
+    return NULL;
+}
+
+/*
+ * one worker, runs tasks until the pool stops and nothing is left
+ */
+static void* wolfsslPoolWorker(void* arg)
+{
+    WolfsslPool* pool = (WolfsslPool*) arg;
+    WolfsslTask* task;          /* task being run */
+    int          worker;        /* index of this worker */
+    int          ret;           /* what the task returned */
+
+    pthread_mutex_lock(&pool->lock);
+    worker = pool->next++;
+
+    for (;;) {
+        if (interrupted && pool->cancelled == 0)
+            wolfsslPoolDrop(pool);
+
+        task = wolfsslPoolTake(pool, worker);
+        if (task == NULL && pool->stop)
+            break;
+        if (task == NULL) {
+            pthread_cond_wait(&pool->work, &pool->lock);
+            continue;
+        }
+
+        task->state = WOLFSSL_TASK_RUNNING;
+        pthread_mutex_unlock(&pool->lock);
+
+        ret = task->func(task->arg, worker);
+        wolfsslPoolFinish(pool, task, ret);
+
+        pthread_mutex_lock(&pool->lock);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+#endif /* HAVE_PTHREAD */
+
+/*
+ * starts up to threads workers
+ */
+int wolfsslPoolInit(WolfsslPool* pool, int threads, int depth)
+{
+    XMEMSET(pool, 0, sizeof(WolfsslPool));
+    pool->depth = depth > 0 ? depth : 1;
+
+    wolfsslPoolCatch();
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->room, NULL);
+    pthread_cond_init(&pool->finished, NULL);
+
+    if (threads > MAX_THREADS)
+        threads = MAX_THREADS;
+    while (pool->threads < threads) {
+        if (pthread_create(&pool->tids[pool->threads], NULL,
+                                            wolfsslPoolWorker, pool) != 0)
+            break;
+        pthread_mutex_lock(&pool->lock);
+        pool->threads++;
+        pthread_mutex_unlock(&pool->lock);
+    }
+#else
+    (void) threads;
+#endif
+
+    return 0;
+}
+
+/*
+ * fills in a queued task. With workers it is called with the lock held, so
+ * a thread waiting on the task never sees it half set up.
+ */
+static void wolfsslPoolPrepare(WolfsslTask* task, WolfsslTaskFunc func,
+                                        WolfsslTaskDoneFunc done, void* arg)
+{
+    task->func  = func;
+    task->done  = done;
+    task->arg   = arg;
+    task->ret   = 0;
+    task->next  = NULL;
+    task->prev  = NULL;
+    task->state = WOLFSSL_TASK_QUEUED;
+}
+
+/*
+ * queues task, or runs it here when the pool has no workers
+ */
+int wolfsslPoolSubmit(WolfsslPool* pool, WolfsslTask* task,
+                WolfsslTaskFunc func, WolfsslTaskDoneFunc done, void* arg)
+{
+    if (pool->threads == 0) {
+        wolfsslPoolPrepare(task, func, done, arg);
+        if (wolfsslPoolCancelled(pool)) {
+            wolfsslPoolFinish(pool, task, POOL_CANCELLED);
+            return POOL_CANCELLED;
+        }
+        task->state = WOLFSSL_TASK_RUNNING;
+        wolfsslPoolFinish(pool, task, func(arg, 0));
+        return 0;
+    }
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&pool->lock);
+    wolfsslPoolPrepare(task, func, done, arg);
+    while (pool->queued >= pool->depth && pool->cancelled == 0 &&
+                                                            interrupted == 0)
+        pthread_cond_wait(&pool->room, &pool->lock);
+    if (pool->cancelled || interrupted) {
+        pthread_mutex_unlock(&pool->lock);
+        wolfsslPoolFinish(pool, task, POOL_CANCELLED);
+        return POOL_CANCELLED;
+    }
+
+    if (pool->tail != NULL)
+        pool->tail->next = task;
+    else
+        pool->head = task;
+    pool->tail = task;
+    pool->queued++;
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+#endif
+
+    return 0;
+}
+
+/*
+ * pushes task onto the running worker's deque and wakes an idle worker to
+ * steal it
+ */
+int wolfsslPoolSpawn(WolfsslPool* pool, int worker, WolfsslTask* task,
+                WolfsslTaskFunc func, WolfsslTaskDoneFunc done, void* arg)
+{
+#ifdef HAVE_PTHREAD
+    WolfsslDeque* deque = &pool->deques[worker];
+#endif
+
+    if (pool->threads == 0)
+        return wolfsslPoolSubmit(pool, task, func, done, arg);
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&pool->lock);
+    wolfsslPoolPrepare(task, func, done, arg);
+    if (pool->cancelled || interrupted) {
+        pthread_mutex_unlock(&pool->lock);
+        wolfsslPoolFinish(pool, task, POOL_CANCELLED);
+        return POOL_CANCELLED;
+    }
+    task->prev = deque->tail;
+    if (deque->tail != NULL)
+        deque->tail->next = task;
+    else
+        deque->head = task;
+    deque->tail = task;
+    pool->spawned++;
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+#else
+    (void) worker;
+#endif
+
+    return 0;
+}
+
+/*
+ * checks on a task without waiting for it
+ */
+int wolfsslPoolPoll(WolfsslPool* pool, WolfsslTask* task)
+{
+    int done;
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&pool->lock);
+#endif
+    done = (task->state == WOLFSSL_TASK_DONE);
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&pool->lock);
+#else
+    (void) pool;
+#endif
+
+    return done;
+}
+
+/*
+ * waits for a task to be done, the future's result
+ */
+int wolfsslPoolWait(WolfsslPool* pool, WolfsslTask* task)
+{
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&pool->lock);
+    while (task->state != WOLFSSL_TASK_DONE)
+        pthread_cond_wait(&pool->finished, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+#else
+    (void) pool;
+#endif
+
+    return task->ret;
+}
+
+/*
+ * drops the queue, later submissions are refused
+ */
+void wolfsslPoolCancel(WolfsslPool* pool)
+{
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&pool->lock);
+    wolfsslPoolDrop(pool);
+    pthread_mutex_unlock(&pool->lock);
+#else
+    pool->cancelled = 1;
+#endif
+}
+
+/*
+ * whether work should stop
+ */
+int wolfsslPoolCancelled(WolfsslPool* pool)
+{
+    int cancelled;
+
+    if (interrupted)
+        return 1;
+    if (pool == NULL)
+        return 0;
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&pool->lock);
+#endif
+    cancelled = pool->cancelled;
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&pool->lock);
+#endif
+
+    return cancelled;
+}
+
+/*
+ * lets the workers drain the queue, then joins them
+ */
+void wolfsslPoolFree(WolfsslPool* pool)
+{
+#ifdef HAVE_PTHREAD
+    int i;                      /* loop variable */
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->threads; i++)
+        pthread_join(pool->tids[i], NULL);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work);
+    pthread_cond_destroy(&pool->room);
+    pthread_cond_destroy(&pool->finished);
+#endif
+    pool->threads = 0;
+}
@@ -0,0 +1,215 @@
+/* wolfsslStream.c
+ *
+ * Copyright (C) 2006-2015 wolfSSL Inc.
+ *
+ * This file is part of wolfSSL. (formerly known as CyaSSL)
+ *
+ * wolfSSL is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfSSL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "include/wolfssl.h"
+
+/*
+ * opens a stream on a file, 'r' for reading, 'w' to create or truncate
+ */
+int wolfsslStreamOpen(WolfsslStream* stream, const char* name, char mode)
+{
+    struct stat st;         /* file status, used for the length */
+
+    stream->fd     = -1;
+    stream->offset = 0;
+    stream->length = 0;
+    stream->map    = NULL;
+
+    if (mode == 'r')
+        stream->fd = open(name, O_RDONLY);
+    else if (mode == 'w')
+        /* read-write so the output can also be mapped */
+        stream->fd = open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (stream->fd < 0)
+        return mode == 'r' ? FREAD_ERROR : FWRITE_ERROR;
+
+    if (fstat(stream->fd, &st) != 0) {
+        wolfsslStreamClose(stream);
+        return FREAD_ERROR;
+    }
+    stream->length = (int64_t) st.st_size;
+
+    return 0;
+}
+
+/*
+ * reads up to sz bytes, only returns short at the end of the file
+ */
+int wolfsslStreamRead(WolfsslStream* stream, byte* buf, int sz)
+{
+    int     total = 0;      /* bytes placed in buf so far */
+    ssize_t got;            /* bytes returned by a single read */
+
+    while (total < sz) {
+        got = read(stream->fd, buf + total, (size_t)(sz - total));
+        if (got < 0) {
+            if (errno == EINTR)
+                continue;
+            return FREAD_ERROR;
+        }
+        if (got == 0)
+            break;
+        total += (int) got;
+    }
+    stream->offset += total;
+
+    return total;
+}
+
+/*
+ * writes all sz bytes of buf to the stream
+ */
+int wolfsslStreamWrite(WolfsslStream* stream, const byte* buf, int sz)
+{
+    int     total = 0;      /* bytes written so far */
+    ssize_t put;            /* bytes taken by a single write */
+
+    while (total < sz) {
+        put = write(stream->fd, buf + total, (size_t)(sz - total));
+        if (put < 0) {
+            if (errno == EINTR)
+                continue;
+            return FWRITE_ERROR;
+        }
+        total += (int) put;
+    }
+    stream->offset += total;
+    if (stream->offset > stream->length)
+        stream->length = stream->offset;
+
+    return 0;
+}
+
+/*
+ * reads up to sz bytes at offset without moving the stream, safe to call
+ * from several threads at once
+ */
+int wolfsslStreamReadAt(WolfsslStream* stream, byte* buf, int sz,
+                                                                int64_t offset)
+{
+    int     total = 0;      /* bytes placed in buf so far */
+    ssize_t got;            /* bytes returned by a single pread */
+
+    while (total < sz) {
+        got = pread(stream->fd, buf + total, (size_t)(sz - total),
+                                                    (off_t)(offset + total));
+        if (got < 0) {
+            if (errno == EINTR)
+                continue;
+            return FREAD_ERROR;
+        }
+        if (got == 0)
+            break;
+        total += (int) got;
+    }
+
+    return total;
+}
+
+/*
+ * writes all sz bytes of buf at offset without moving the stream, safe to
+ * call from several threads at once
+ */
+int wolfsslStreamWriteAt(WolfsslStream* stream, const byte* buf, int sz,
+                                                                int64_t offset)
+{
+    int     total = 0;      /* bytes written so far */
+    ssize_t put;            /* bytes taken by a single pwrite */
+
+    while (total < sz) {
+        put = pwrite(stream->fd, buf + total, (size_t)(sz - total),
+                                                    (off_t)(offset + total));
+        if (put < 0) {
+            if (errno == EINTR)
+                continue;
+            return FWRITE_ERROR;
+        }
+        total += (int) put;
+    }
+
+    return 0;
+}
+
+/*
+ * grows or shrinks the file behind the stream to length bytes
+ */
+int wolfsslStreamResize(WolfsslStream* stream, int64_t length)
+{
+    if (ftruncate(stream->fd, (off_t) length) != 0)
+        return FWRITE_ERROR;
+
+    stream->length = length;
+    if (stream->offset > length)
+        stream->offset = length;
+
+    return 0;
+}
+
+/*
+ * maps the whole file, read-only and sequential for 'r', writable for 'w'
+ */
+int wolfsslStreamMap(WolfsslStream* stream, char mode)
+{
+    void*   map;            /* result of mmap */
+    int     prot;           /* page protection */
+
+    stream->map = NULL;
+    if (stream->length == 0)
+        return 0;
+    if ((uint64_t) stream->length > (uint64_t) SIZE_MAX)
+        return mode == 'r' ? FREAD_ERROR : FWRITE_ERROR;
+
+    prot = (mode == 'r') ? PROT_READ : PROT_READ | PROT_WRITE;
+    map  = mmap(NULL, (size_t) stream->length, prot, MAP_SHARED, stream->fd,
+                                                                            0);
+    if (map == MAP_FAILED)
+        return mode == 'r' ? FREAD_ERROR : FWRITE_ERROR;
+
+#ifdef MADV_SEQUENTIAL
+    /* the data paths walk the file once, front to back */
+    madvise(map, (size_t) stream->length, MADV_SEQUENTIAL);
+#endif
+    stream->map = (byte*) map;
+
+    return 0;
+}
+
+/*
+ * removes the mapping of the file
+ */
+void wolfsslStreamUnmap(WolfsslStream* stream)
+{
+    if (stream->map != NULL)
+        munmap(stream->map, (size_t) stream->length);
+    stream->map = NULL;
+}
+
+/*
+ * closes the stream's descriptor
+ */
+void wolfsslStreamClose(WolfsslStream* stream)
+{
+    wolfsslStreamUnmap(stream);
+    if (stream->fd >= 0)
+        close(stream->fd);
+    stream->fd = -1;
+}
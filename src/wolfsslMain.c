@@ -76,6 +76,44 @@ int main(int argc, char** argv)
             case TIME:      break;
             /* Verify results, used with -iv and -key */
             case VERIFY:    break;
+            /* bytes en/de crypted at a time */
+            case CHUNK:     break;
+            /* worker threads for seekable modes */
+            case THREADS:   break;
+            /* map files instead of reading them */
+            case MMAP:      break;
+            /* overlapped io backend */
+            case BACKEND:   break;
+            /* file holding names of files to hash */
+            case INLIST:    break;
+            /* names in -inlist are NUL separated */
+            case NULLDELIM: break;
+            /* BSD style hash lines */
+            case TAG:       break;
+            /* manifest of digests to verify */
+            case CHECK:     break;
+            /* per chunk digests in hash output */
+            case CHUNKS:    break;
+            /* only report failed checks */
+            case QUIET:     break;
+            /* buffer sizes to benchmark with */
+            case SIZES:     break;
+            /* timed runs of each benchmark */
+            case REPS:      break;
+            /* benchmark output format */
+            case FORMAT:    break;
+            /* earlier benchmark results to compare with */
+            case BASELINE:  break;
+            /* slowdown against the baseline that fails */
+            case THRESHOLD: break;
+            /* cipher operations to benchmark */
+            case OPS:       break;
+            /* PBKDF2 iterations when encrypting */
+            case KDFITER:   break;
+            /* time PBKDF2 should take when encrypting */
+            case KDFTARGET: break;
+            /* benchmark the latency of each call */
+            case LATENCY:   break;
             /* which version of clu am I using */
             case VERBOSE:
                             wolfsslVerboseHelp();
@@ -93,6 +131,8 @@ int main(int argc, char** argv)
 
     if (ret != 0)
         printf("Error returned: %d.\n", ret);
+    wolfsslBufDrain();
+    wolfsslKeyDrain();
 
     return ret;
 }
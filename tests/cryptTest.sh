@@ -0,0 +1,158 @@
+#!/bin/bash
+# Round trips through the -threads range split, where each cbc range takes
+# its IV from the ciphertext block before it and the last one carries the
+# padding, through -mmap, where decrypt trims the padding after unmapping,
+# and through the -io uring and -io thread pipelines, which must hand cbc
+# its chunks in order however the reads and writes complete. With a fixed
+# key and IV their cipher text must also match the serial one. Run by make
+# check from the build directory, or by hand with WOLFSSL set to the binary.
+GREEN='\e[0;32m'
+RED='\e[0;31m'
+NC='\e[0m'
+WOLFSSL=${WOLFSSL:-./wolfssl}
+CHUNK=4096
+IO_DEPTH=8
+KEY=0123456789abcdef0123456789abcdef
+KEY256=${KEY}fedcba9876543210fedcba9876543210
+IV=00112233445566778899aabbccddeeff
+fail=0
+total=0
+
+dir="$(mktemp -d)" || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+# makes $1 holding $2 random bytes
+function mkfile() {
+    head -c $2 /dev/urandom > "$dir/$1"
+}
+
+# encrypts and decrypts $2 with cipher $1 and the options after it, the
+# result must match the original byte for byte
+function roundtrip() {
+    local alg=$1
+    local file="$dir/$2"
+    shift 2
+    total=$[total+1]
+    if ! $WOLFSSL -encrypt $alg -in "$file" -out "$file.enc" -chunk $CHUNK \
+                                                    "$@" > /dev/null 2>&1; then
+        echo -e "${RED}$alg $(basename $file) $*: encrypt failed${NC}"
+        fail=$[fail+1]
+    elif ! $WOLFSSL -decrypt $alg -in "$file.enc" -out "$file.dec" \
+                                        -chunk $CHUNK "$@" > /dev/null 2>&1; then
+        echo -e "${RED}$alg $(basename $file) $*: decrypt failed${NC}"
+        fail=$[fail+1]
+    elif ! cmp -s "$file" "$file.dec"; then
+        echo -e "${RED}$alg $(basename $file) $*: output differs${NC}"
+        fail=$[fail+1]
+    fi
+    rm -f "$file.enc" "$file.dec"
+}
+
+# the user set key for cipher $1, as many hex digits as its key has bits / 4
+function keyfor() {
+    local bits=${1##*-}
+    echo ${KEY256:0:$[bits / 4]}
+}
+
+# encrypts $2 with cipher $1, the user set key and IV and the options after
+# it. A keystream started at the wrong counter decrypts fine with the same
+# options, so the cipher text must match the serial one byte for byte.
+function samecipher() {
+    local alg=$1
+    local file="$dir/$2"
+    local key=$(keyfor $1)
+    shift 2
+    total=$[total+1]
+    $WOLFSSL -encrypt $alg -in "$file" -out "$file.serial" -chunk $CHUNK \
+                                -key $key -iv $IV > /dev/null 2>&1
+    if ! $WOLFSSL -encrypt $alg -in "$file" -out "$file.enc" -key $key \
+                                        -iv $IV "$@" > /dev/null 2>&1; then
+        echo -e "${RED}$alg $(basename $file) $*: encrypt failed${NC}"
+        fail=$[fail+1]
+    elif ! cmp -s "$file.serial" "$file.enc"; then
+        echo -e "${RED}$alg $(basename $file) $*: cipher text differs${NC}"
+        fail=$[fail+1]
+    fi
+    rm -f "$file.serial" "$file.enc"
+}
+
+# encrypts $2 with cipher $1 and the user set key and IV using the options
+# in $3, then decrypts it using the options in $4
+function crossmode() {
+    local alg=$1
+    local file="$dir/$2"
+    local key=$(keyfor $1)
+    total=$[total+1]
+    if ! $WOLFSSL -encrypt $alg -in "$file" -out "$file.enc" -chunk $CHUNK \
+                                -key $key -iv $IV $3 > /dev/null 2>&1 ||
+       ! $WOLFSSL -decrypt $alg -in "$file.enc" -out "$file.dec" \
+                    -chunk $CHUNK -key $key -iv $IV $4 > /dev/null 2>&1; then
+        echo -e "${RED}$alg $(basename $file) '$3' to '$4': failed${NC}"
+        fail=$[fail+1]
+    elif ! cmp -s "$file" "$file.dec"; then
+        echo -e "${RED}$alg $(basename $file) '$3' to '$4': output differs${NC}"
+        fail=$[fail+1]
+    fi
+    rm -f "$file.enc" "$file.dec"
+}
+
+# empty, one block, a byte short of a block, several chunks and 3 bytes,
+# a file smaller than a chunk and one of IO_DEPTH+1 chunks, more than the
+# pipelines keep in flight
+function mkfiles() {
+    mkfile empty 0
+    mkfile block $1
+    mkfile short $[$1 - 1]
+    mkfile chunks $[CHUNK*5 + 3]
+    mkfile whole $[CHUNK*5]
+    mkfile small 100
+    mkfile depth $[CHUNK*(IO_DEPTH + 1)]
+}
+
+echo Testing...
+for cipher in aes-cbc-128:16 aes-cbc-256:16 3des-cbc-168:8 \
+              camellia-cbc-128:16 camellia-cbc-256:16 aes-ctr-128:16; do
+    alg=${cipher%:*}
+    mkfiles ${cipher#*:}
+    for file in empty block short chunks small depth; do
+        for opts in "-threads 1" "-threads 2" "-threads 4" "-io thread" \
+                    "-io uring" "-io uring -threads 3" "-mmap"; do
+            roundtrip $alg $file -pwd secret -kdf-iter 1000 $opts
+        done
+    done
+done
+
+# a user set key and IV, the first range's IV comes from -iv. Those files
+# have no salt to say they are padded, so only whole blocks round trip
+mkfiles 16
+for file in block whole depth; do
+    for opts in "-threads 4" "-io thread" "-io uring"; do
+        roundtrip aes-cbc-128 $file -key $KEY -iv $IV $opts
+    done
+done
+
+# the parallel and pipelined cipher texts against the serial one, for ctr
+# ranges that start mid message and chunks of another size
+for alg in aes-ctr-128 aes-ctr-256 aes-cbc-128; do
+    for file in block short chunks whole depth; do
+        for opts in "-threads 2 -chunk $CHUNK" "-threads 4 -chunk $CHUNK" \
+                    "-io thread -chunk $CHUNK" "-io uring -chunk $CHUNK" \
+                    "-chunk 1k" "-threads 4 -chunk 1k"; do
+            samecipher $alg $file $opts
+        done
+    done
+    # serial cipher text decrypted in parallel, and the other way round
+    for file in block whole depth; do
+        crossmode $alg $file "" "-threads 4"
+        crossmode $alg $file "" "-io uring"
+        crossmode $alg $file "-threads 4" ""
+        crossmode $alg $file "-io uring" ""
+    done
+done
+
+if [ $fail = 0 ]; then
+    echo -e "${GREEN}All $total Round Trips Passed${NC}"
+else
+    echo -e "${RED}$fail/$total Round Trips Failed${NC}"
+    exit 1
+fi
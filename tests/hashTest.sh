@@ -0,0 +1,151 @@
+#!/bin/bash
+# Checks -hash against coreutils and -check's exit status. Run by make check
+# from the build directory, or by hand with WOLFSSL set to the binary.
+GREEN='\e[0;32m'
+RED='\e[0;31m'
+NC='\e[0m'
+WOLFSSL=${WOLFSSL:-./wolfssl}
+srcdir=${srcdir:-.}
+fail=0
+total=0
+
+dir="$(mktemp -d)" || exit 1
+trap 'rm -rf "$dir"' EXIT
+# the checks run in $dir so the names printed match coreutils'
+WOLFSSL="$(cd "$(dirname "$WOLFSSL")" && pwd)/$(basename "$WOLFSSL")"
+
+# makes $1 holding $2 random bytes
+function mkfile() {
+    head -c $2 /dev/urandom > "$dir/$1"
+}
+
+# runs wolfssl in $dir with the arguments after $1, the name of the check,
+# its output must match $dir/want
+function same() {
+    local name=$1
+    shift
+    total=$[total+1]
+    if ! (cd "$dir" && $WOLFSSL "$@" > got 2> /dev/null); then
+        echo -e "${RED}$name: failed${NC}"
+        fail=$[fail+1]
+    elif ! diff "$dir/want" "$dir/got" > /dev/null; then
+        echo -e "${RED}$name: output differs${NC}"
+        diff "$dir/want" "$dir/got" | head -4
+        fail=$[fail+1]
+    fi
+}
+
+# runs wolfssl in $dir with the arguments after $2, the name of the check,
+# it must exit with status $1
+function status() {
+    local want=$1
+    local name=$2
+    local got
+    shift 2
+    total=$[total+1]
+    (cd "$dir" && $WOLFSSL "$@" > /dev/null 2>&1)
+    got=$?
+    if [ $got != $want ]; then
+        echo -e "${RED}$name: exit status $got, expected $want${NC}"
+        fail=$[fail+1]
+    fi
+}
+
+# one byte of file $1 at offset $2 changed
+function corrupt() {
+    printf 'Z' | dd of="$dir/$1" bs=1 seek=$2 conv=notrunc 2> /dev/null
+}
+
+echo Testing...
+mkfile empty 0
+mkfile small 100
+mkfile big $[300 * 1024 + 7]
+files="empty small big"
+
+# -mmap, including a zero length file that can't be mapped
+(cd "$dir" && sha256sum $files > want)
+same "-hash sha256 -mmap" -hash sha256 -mmap -in $files
+for file in $files; do
+    (cd "$dir" && sha256sum $file | cut -d ' ' -f 1 > want)
+    same "-hash sha256 -mmap $file" -hash sha256 -mmap -in $file
+done
+
+# many files of mixed sizes are hashed largest first but reported in the
+# order given, names escaped the way coreutils does
+mkfile huge $[3 * 1024 * 1024 + 1]
+printf 'abc' > "$dir/back\\slash"
+printf 'x' > "$dir/new"$'\n'"line"
+names=(small huge empty "back\\slash" "new"$'\n'"line" big)
+(cd "$dir" && sha256sum "${names[@]}" > want)
+same "-hash sha256 -in" -hash sha256 -in "${names[@]}"
+same "-hash sha256 -in -threads 4" -hash sha256 -threads 4 -in "${names[@]}"
+printf '%s\0' "${names[@]}" > "$dir/list"
+same "-hash sha256 -inlist -null" -hash sha256 -threads 4 -inlist list -null
+(cd "$dir" && printf '%s\0' "${names[@]}" |
+    $WOLFSSL -hash sha256 -inlist - -null > got 2> /dev/null)
+total=$[total+1]
+if ! diff "$dir/want" "$dir/got" > /dev/null; then
+    echo -e "${RED}-hash sha256 -inlist - -null: output differs${NC}"
+    fail=$[fail+1]
+fi
+
+# several algorithms in one pass, each file's digests in the order asked,
+# in BSD tag format, nothing swapped between algorithms or files
+multi=(small empty big huge)
+(cd "$dir" && for file in "${multi[@]}"; do
+    sha256sum --tag "$file"
+    md5sum --tag "$file"
+done > want)
+same "-hash sha256,md5" -hash sha256,md5 -in "${multi[@]}"
+same "-hash sha256,md5 -tag" -hash sha256,md5 -tag -in "${multi[@]}"
+same "-hash sha256,md5 -threads 3" -hash sha256,md5 -threads 3 \
+                                                        -in "${multi[@]}"
+same "-hash sha256,md5 -mmap" -hash sha256,md5 -mmap -in "${multi[@]}"
+(cd "$dir" && sha256sum --tag "${multi[@]}" > want)
+same "-hash sha256 -tag" -hash sha256 -tag -in "${multi[@]}"
+(cd "$dir" && md5sum --tag "${multi[@]}" > want)
+same "-hash md5 -tag" -hash md5 -tag -in "${multi[@]}"
+
+# -check, 0 when every file matches, 1 for a mismatch and the error's
+# status for unreadable files and malformed lines
+(cd "$dir" && sha256sum small big > manifest)
+status 0 "-check clean" -hash sha256 -check manifest -quiet
+cp "$dir/big" "$dir/big.orig"
+corrupt big 1000
+status 1 "-check corrupted" -hash sha256 -check manifest -quiet
+mv "$dir/big.orig" "$dir/big"
+mv "$dir/small" "$dir/small.orig"
+status 198 "-check missing" -hash sha256 -check manifest -quiet
+mv "$dir/small.orig" "$dir/small"
+(cat "$dir/manifest"; echo "not a digest line") > "$dir/malformed"
+status 199 "-check malformed" -hash sha256 -check malformed -quiet
+
+# a -chunks manifest, one changed chunk fails the file
+(cd "$dir" && $WOLFSSL -hash sha256 -chunks -chunk 64k -in huge \
+                                                > chunks 2> /dev/null)
+status 0 "-check -chunks clean" -hash sha256 -check chunks -quiet
+corrupt huge $[5 * 64 * 1024 + 3]
+status 1 "-check -chunks corrupted" -hash sha256 -check chunks -quiet
+
+# the NIST lists hold bare digests, -check pairs them with -in in order
+for list in sha1:sha md5:md5; do
+    i=0
+    files=()
+    while [[ $i -lt $(wc -l < "$srcdir/tests/byte-hashes.${list%:*}") ]]; do
+        files+=("$(printf 'byte%04d.dat' $i)")
+        i=$[i+1]
+    done
+    total=$[total+1]
+    if ! (cd "$srcdir/tests" && $WOLFSSL -hash ${list#*:} -check \
+            byte-hashes.${list%:*} -in "${files[@]}" -quiet > /dev/null); then
+        echo -e "${RED}-check byte-hashes.${list%:*}: failed${NC}"
+        fail=$[fail+1]
+    fi
+done
+
+if [ $fail = 0 ]; then
+    echo -e "${GREEN}All $total Hash Tests Passed${NC}"
+else
+    echo -e "${RED}$fail/$total Hash Tests Failed${NC}"
+    exit 1
+fi